@@ -2,16 +2,18 @@
 #include <iostream>
 #include <cstring>
 #include <cstdio>
+#include <cstddef>
 
+// 容量与下标用size_t，可容纳超过2^31个元素
 struct Queue {
     int* elems;
-    int max;
-    int head;
-    int tail;
+    size_t max;
+    size_t head;
+    size_t tail;
 };
 
 // 初始化队列，分配m个元素 
-void queInit(Queue* const p, int m) {
+void queInit(Queue* const p, ptrdiff_t m) {
     if (p == nullptr) {
         std::cerr << "Error: p is null in queInit(int m)" << std::endl;
         return;
@@ -20,7 +22,11 @@ void queInit(Queue* const p, int m) {
         std::cerr << "Error: Queue already initialized in queInit(int m)" << std::endl;
         return;
     }
-    p->elems = new int[m];
+    if (m <= 0) {
+        std::cerr << "Error: m must be positive in queInit(int m)" << std::endl;
+        return;
+    }
+    p->elems = new int[m];//new[]自行检查m*sizeof(int)是否溢出，溢出时抛bad_array_new_length
     p->max = m;
     p->head = 0;
     p->tail = 0;
@@ -37,7 +43,7 @@ void queInit(Queue* const p, const Queue& q) {
         return;
     }
     p->elems = new int[q.max];
-    for (int i = 0; i < q.max; ++i)
+    for (size_t i = 0; i < q.max; ++i)
         p->elems[i] = q.elems[i];
     p->max = q.max;
     p->head = q.head;
@@ -45,21 +51,21 @@ void queInit(Queue* const p, const Queue& q) {
 }
 
 // 返回队列的最大容量
-int queSize(const Queue* const p) {
+ptrdiff_t queSize(const Queue* const p) {
     if (p == nullptr) {
         std::cerr << "Error: p is null in queSize" << std::endl;
         return -1;
     }
-    return p->max-1;
+    return (ptrdiff_t)p->max - 1;
 }
 
 // 返回队列当前元素个数
-int queNumber(const Queue* const p) {
+ptrdiff_t queNumber(const Queue* const p) {
     if (p == nullptr) {
         std::cerr << "Error: p is null in queNumber" << std::endl;
         return -1;
     }
-    return (p->tail >= p->head) ? (p->tail - p->head) : (p->max - p->head + p->tail);
+    return (ptrdiff_t)((p->tail >= p->head) ? (p->tail - p->head) : (p->max - p->head + p->tail));
 }
 
 // 元素入队
@@ -100,7 +106,7 @@ Queue* const queAssign(Queue* const p, const Queue& q) {
     }
     delete[] p->elems;
     p->elems = new int[q.max];//清空后重新分配，防止q.max过大
-    for (int i = 0; i < q.max; ++i)
+    for (size_t i = 0; i < q.max; ++i)
         p->elems[i] = q.elems[i];
     p->max = q.max;
     p->head = q.head;
@@ -115,7 +121,7 @@ void quePrint(const Queue* const p, char* s) {
         return;
     }
     s[0] = '\0';//将s置空
-    int current = p->head;
+    size_t current = p->head;
     while (current != p->tail) {
         char temp[20];
         sprintf_s(temp, "%d ", p->elems[current]);//用 sprintf_s 函数将当前队列元素格式化为字符串，并追加一个空格
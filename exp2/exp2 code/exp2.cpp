@@ -2,28 +2,275 @@
 #include <iostream>
 #include <cstdarg>
 #include <cstring>
+#include <cstddef>
+#include <vector>
+#include <deque>
+#include <memory>
+#include <algorithm>
+#include <chrono>
 using namespace std;
 
-class QUEUE {
-    int* const elems;  // 存储队列元素的数组
-    const int max;      // 队列最大容量
-    int head;           // 队首指针
-    int tail;           // 队尾指针
+// 统计开关: 编译时定义QUEUE_STATS=0即关闭
+#ifndef QUEUE_STATS
+#define QUEUE_STATS 1
+#endif
+
+// 统计快照
+struct QueueStats {
+    size_t occupancy;   // 当前元素个数
+    size_t highWater;   // 元素个数的历史最大值
+    size_t enters;      // 成功进入的元素数
+    size_t leaves;      // 成功离开的元素数
+    size_t wraps;       // 内部环形数组的首尾指针回绕到0的次数
+    size_t rejected;    // 因已满被拒绝的进入次数
+    size_t batches;     // 批量进入、离开的调用次数
+    size_t batchItems;  // 批量操作涉及的元素总数
+    double avgBatch() const { return batches ? (double)batchItems / batches : 0; }
+};
 
+// MSVC默认只对第一个空基类做空基类优化
+#if defined(_MSC_VER)
+#define QUEUE_EMPTY_BASES __declspec(empty_bases)
+#else
+#define QUEUE_EMPTY_BASES
+#endif
+
+enum QueueCounter { QC_HIGH, QC_ENTER, QC_LEAVE, QC_WRAP, QC_REJECT, QC_BATCH, QC_BATCH_ITEM, QC_COUNT };
+
+// 每个实例的计数器，拷贝、移动时不随内容转移
+template <bool On, class Tag = void>
+class QueueCounters {
+    size_t c[QC_COUNT];
 public:
-    // 构造函数
-    QUEUE(int m) : elems(new int[m]), max(m), head(0), tail(0) {
+    QueueCounters() { reset(); }
+    QueueCounters(const QueueCounters&) { reset(); }
+    QueueCounters& operator=(const QueueCounters&) { return *this; }
+    void add(QueueCounter k, size_t d = 1) { c[k] += d; }
+    void peak(size_t n) { if (n > c[QC_HIGH]) c[QC_HIGH] = n; }
+    void fill(QueueStats& st) const {
+        st.highWater = c[QC_HIGH];
+        st.enters = c[QC_ENTER];
+        st.leaves = c[QC_LEAVE];
+        st.wraps = c[QC_WRAP];
+        st.rejected = c[QC_REJECT];
+        st.batches = c[QC_BATCH];
+        st.batchItems = c[QC_BATCH_ITEM];
+    }
+    void reset() { for (auto& x : c) x = 0; }
+};
+
+// 关闭统计时为空类
+template <class Tag>
+class QueueCounters<false, Tag> {
+public:
+    void add(QueueCounter, size_t = 1) {}
+    void peak(size_t) {}
+    void fill(QueueStats& st) const { st = QueueStats(); }
+    void reset() {}
+};
+
+// 打印统计快照
+inline void printStats(const char* s, const QueueStats& st) {
+    std::cout << s << "occupancy " << st.occupancy << ", high " << st.highWater
+              << ", enters " << st.enters << ", leaves " << st.leaves << ", wraps " << st.wraps
+              << ", rejected " << st.rejected << ", batches " << st.batches
+              << ", avg batch " << st.avgBatch() << std::endl;
+}
+
+// 延迟统计开关: 编译时定义QUEUE_LATENCY=0即关闭
+#ifndef QUEUE_LATENCY
+#define QUEUE_LATENCY 1
+#endif
+
+// 分支提示与禁止内联
+#if defined(__GNUC__)
+#define QUEUE_UNLIKELY(x) __builtin_expect(!!(x), 0)
+#define QUEUE_NOINLINE __attribute__((noinline, cold))
+#elif defined(_MSC_VER)
+#define QUEUE_UNLIKELY(x) (x)
+#define QUEUE_NOINLINE __declspec(noinline)
+#else
+#define QUEUE_UNLIKELY(x) (x)
+#define QUEUE_NOINLINE
+#endif
+
+// 对数分桶直方图(纳秒)，每个2的幂区间分16个子桶，相对误差不超过1/16
+class LatencyHistogram {
+public:
+    static const int SUB_BITS = 4, SUB = 1 << SUB_BITS, BUCKETS = (64 - SUB_BITS + 1) * SUB;
+
+    LatencyHistogram() : buckets(BUCKETS, 0), total(0), maxSeen(0) {}
+
+    void record(unsigned long long ns) {
+        ++buckets[bucketOf(ns)];
+        ++total;
+        if (ns > maxSeen) maxSeen = ns;
+    }
+
+    unsigned long long count() const { return total; }
+    unsigned long long max() const { return maxSeen; }
+
+    // 分位数(p取0~1)，返回所在桶的上界，不超过实际最大值；无样本时为0
+    unsigned long long percentile(double p) const {
+        if (total == 0) return 0;
+        unsigned long long want = (unsigned long long)(p * total);
+        if (want < p * total) ++want;
+        if (want == 0) want = 1;
+        unsigned long long seen = 0;
+        for (int i = 0; i < BUCKETS; ++i) {
+            seen += buckets[i];
+            if (seen >= want) return upperOf(i) < maxSeen ? upperOf(i) : maxSeen;
+        }
+        return maxSeen;
+    }
+    unsigned long long p50() const { return percentile(0.5); }
+    unsigned long long p99() const { return percentile(0.99); }
+    unsigned long long p999() const { return percentile(0.999); }
+
+    void reset() {
+        std::fill(buckets.begin(), buckets.end(), 0ULL);
+        total = maxSeen = 0;
+    }
+
+private:
+    std::vector<unsigned long long> buckets;
+    unsigned long long total, maxSeen;
+
+    // 小于16的值各占一桶；否则取最高位所在的2的幂区间，再取其后4位作子桶
+    static int bucketOf(unsigned long long v) {
+        if (v < SUB) return (int)v;
+        int e = SUB_BITS;
+        while (e < 63 && (v >> (e + 1)) != 0) ++e;
+        return (e - SUB_BITS + 1) * SUB + (int)((v >> (e - SUB_BITS)) & (SUB - 1));
+    }
+    static unsigned long long upperOf(int i) {
+        if (i < SUB) return (unsigned long long)i;
+        const int e = i / SUB + SUB_BITS - 1, shift = e - SUB_BITS;
+        const unsigned long long lower = (unsigned long long)(SUB + i % SUB) << shift;
+        return lower + ((1ULL << shift) - 1);
+    }
+};
+
+// 停留时间采样，默认关闭；每2^shift个入队元素记下(序号, 时刻)，出队序号追上时记入直方图
+template <bool On>
+class QueueLatency {
+    struct State {
+        std::deque<std::pair<unsigned long long, long long>> pending;
+        unsigned long long enterSeq, leaveSeq, nextLeave, mask; // nextLeave为最早一个采样的序号，无采样时为最大值
+        LatencyHistogram hist;
+    };
+    State* st; // 未开启时为nullptr
+
+    static long long now() {
+        return std::chrono::duration_cast<std::chrono::nanoseconds>(
+            std::chrono::steady_clock::now().time_since_epoch()).count();
+    }
+    // 采样路径不内联，只接收State指针，避免队列对象逃逸
+    QUEUE_NOINLINE static void stamp(State* s) {
+        s->pending.emplace_back(s->enterSeq, now());
+        if (s->pending.size() == 1) s->nextLeave = s->enterSeq;
+    }
+    QUEUE_NOINLINE static void finish(State* s) {
+        s->hist.record((unsigned long long)(now() - s->pending.front().second));
+        s->pending.pop_front();
+        s->nextLeave = s->pending.empty() ? ~0ULL : s->pending.front().first;
+    }
+    QUEUE_NOINLINE static void restart(State* s, size_t n) {
+        s->pending.clear();
+        s->nextLeave = ~0ULL;
+        s->enterSeq = s->leaveSeq + n;
+    }
+    QUEUE_NOINLINE static State* create() { return new State(); }
+    QUEUE_NOINLINE static void destroy(State* s) { delete s; }
+public:
+    QueueLatency() : st(nullptr) {}
+    QueueLatency(const QueueLatency&) : st(nullptr) {}
+    QueueLatency& operator=(const QueueLatency&) { return *this; }
+    ~QueueLatency() {
+        if (st) destroy(st);
+    }
+
+    // shift为采样间隔的对数，0表示每个元素都记录；n为队列当前元素个数，它们不参与统计
+    void enable(unsigned shift, size_t n) {
+        if (!st) st = create();
+        st->mask = shift >= 63 ? ~0ULL : (1ULL << shift) - 1;
+        resync(n);
+    }
+    void disable() {
+        if (st) destroy(st);
+        st = nullptr;
+    }
+    bool enabled() const { return st != nullptr; }
+
+    void entered() {
+        if (QUEUE_UNLIKELY(st != nullptr) && (st->enterSeq++ & st->mask) == 0) stamp(st);
+    }
+    void left() {
+        if (QUEUE_UNLIKELY(st != nullptr) && ++st->leaveSeq >= st->nextLeave) finish(st);
+    }
+    // 元素不经entered入队(如整体拼接)，只推进序号
+    void skip(size_t k) {
+        if (st) st->enterSeq += k;
+    }
+    // 内容被整体替换或清空，丢弃未完成的采样，按当前元素个数重新对齐序号
+    void resync(size_t n) {
+        if (st) restart(st, n);
+    }
+    const LatencyHistogram* histogram() const { return st ? &st->hist : nullptr; }
+    void reset() {
+        if (st) st->hist.reset();
+    }
+};
+
+// 关闭延迟统计时为空类
+template <>
+class QueueLatency<false> {
+public:
+    void enable(unsigned, size_t) {}
+    void disable() {}
+    bool enabled() const { return false; }
+    void entered() {}
+    void left() {}
+    void skip(size_t) {}
+    void resync(size_t) {}
+    const LatencyHistogram* histogram() const { return nullptr; }
+    void reset() {}
+};
+
+// 计数与采样作为空基类，编译时关闭后不占空间
+class QUEUE_EMPTY_BASES QUEUE : QueueCounters<QUEUE_STATS != 0>, QueueLatency<QUEUE_LATENCY != 0> {
+    QueueCounters<QUEUE_STATS != 0>& counters() { return *this; }
+    const QueueCounters<QUEUE_STATS != 0>& counters() const { return *this; }
+    QueueLatency<QUEUE_LATENCY != 0>& latency() { return *this; }
+    const QueueLatency<QUEUE_LATENCY != 0>& latency() const { return *this; }
+
+    int* const elems;  // 存储队列元素的数组
+    const size_t max;   // 队列最大容量，size_t可超过2^31
+    size_t head;        // 队首指针
+    size_t tail;        // 队尾指针
+
+    // 先检查m再分配，new[]自行检查m*sizeof(int)是否溢出
+    static int* alloc(ptrdiff_t m) {
         if (m <= 0) {
             cerr << "Error: max size must be positive." << endl;
             exit(1);
         }
+        return new int[m];
     }
 
+    // 环形下标的后继: 用比较代替取模，容量在运行期才知道时免去一次除法
+    size_t next(size_t i) const { return i + 1 == max ? 0 : i + 1; }
+
+public:
+    // 构造函数
+    QUEUE(ptrdiff_t m) : elems(alloc(m)), max((size_t)m), head(0), tail(0) {}
+
     // 深拷贝构造函数
-    QUEUE(const QUEUE& q) : elems(new int[q.max]), max(q.max), head(q.head), tail(q.tail) {
+    QUEUE(const QUEUE& q)
+        : QueueCounters<QUEUE_STATS != 0>(), QueueLatency<QUEUE_LATENCY != 0>(), elems(new int[q.max]), max(q.max), head(q.head), tail(q.tail) {
         if (head != tail) {
             int** temp = const_cast<int**>(&elems);
-            for (int i = head; i != tail; i++) {
+            for (size_t i = head; i != tail; i++) {
                 if (i == max)
                     i = 0;
                 if (i == tail)
@@ -36,33 +283,39 @@ public:
 
     // 移动构造函数
     QUEUE(QUEUE&& q) noexcept : elems(nullptr), max(q.max), head(q.head), tail(q.tail) {
-        *(const_cast<int*>(&max)) = q.max;
+        *(const_cast<size_t*>(&max)) = q.max;
         *(const_cast<int**>(&elems)) = q.elems;
 
-        *(const_cast<int*>(&q.max)) = 0;
+        *(const_cast<size_t*>(&q.max)) = 0;
         *(const_cast<int**>(&q.elems)) = nullptr;
         q.head = 0;
         q.tail = 0;
+        q.latency().resync(0);
     }
 
     // 返回队列容量
-    int queSize() const { return max; }
+    size_t queSize() const { return max; }
 
     // 返回当前元素个数
-    int queNumber() const {
+    size_t queNumber() const {
         if (max == 0)
             return 0;
-        return (tail - head + max) % max; 
+        return tail >= head ? tail - head : tail + max - head;
     }
 
     // 入队单个元素
     QUEUE& queEnter(int e) {
-        if ((tail + 1) % max == head) {
+        if (next(tail) == head) {
+            counters().add(QC_REJECT);
             cerr << "Error: queue is full." << endl;
             exit(1);
         }
         elems[tail] = e;
-        tail = (tail + 1) % max;
+        tail = next(tail);
+        if (tail == 0) counters().add(QC_WRAP);
+        counters().add(QC_ENTER);
+        counters().peak(queNumber());
+        latency().entered();
         return *this;
     }
 
@@ -72,11 +325,14 @@ public:
             cerr << "Error: n must be positive." << endl;
             exit(1);
         }
-        if (queNumber() + n >= max) {
+        if (queNumber() + (size_t)n >= max) {
+            counters().add(QC_REJECT);
             cerr << "Error: insufficient space." << endl;
             exit(1);
         }
 
+        counters().add(QC_BATCH);
+        counters().add(QC_BATCH_ITEM, (size_t)n);
         va_list args;
         va_start(args, n);
         for (int i = 0; i < n; ++i) {
@@ -94,21 +350,29 @@ public:
             exit(1);
         }
         e = elems[head];
-        head = (head + 1) % max;
+        head = next(head);
+        if (head == 0) counters().add(QC_WRAP);
+        counters().add(QC_LEAVE);
+        latency().left();
         return *this;
     }
 
     // 批量出队到缓冲区
-    QUEUE& queLeave(int& n, int* buf) {
-        if (n <= 0 || buf == nullptr) {
+    QUEUE& queLeave(size_t& n, int* buf) {
+        if (n == 0 || buf == nullptr) {
             cerr << "Error: invalid arguments." << endl;
             exit(1);
         }
-        int count = min(n, queNumber());
-        for (int i = 0; i < count; ++i) {
+        size_t count = min(n, queNumber());
+        for (size_t i = 0; i < count; ++i) {
             buf[i] = elems[head];
-            head = (head + 1) % max;
+            head = next(head);
+            if (head == 0) counters().add(QC_WRAP);
+            latency().left();
         }
+        counters().add(QC_LEAVE, count);
+        counters().add(QC_BATCH);
+        counters().add(QC_BATCH_ITEM, count);
         n = count;
         return *this;
     }
@@ -123,11 +387,11 @@ public:
             return *this;
         head = q.head;
         tail = q.tail;
-        *(const_cast<int*>(&max)) = q.max;
+        *(const_cast<size_t*>(&max)) = q.max;
         *(const_cast<int**>(&elems)) = new int[max];
         if (head != tail) {
             int** ptemp = const_cast<int**>(&elems);//赋值以引用不便直接修改的对象elem
-            for (int i = head; i != tail; i++) {
+            for (size_t i = head; i != tail; i++) {
                 if (i == max)//哨兵
                     i = 0;
                 if (i == tail)
@@ -136,6 +400,7 @@ public:
                     *(*ptemp + i) = q.elems[i];
             }
         }
+        latency().resync(queNumber());
         return *this;
     }
 
@@ -150,41 +415,46 @@ public:
         
         head = q.head;
         tail = q.tail;
-        *(const_cast<int*>(&max)) = q.max;
+        *(const_cast<size_t*>(&max)) = q.max;
         *(const_cast<int**>(&elems)) = q.elems;
-        *(const_cast<int*>(&q.max)) = 0;
+        *(const_cast<size_t*>(&q.max)) = 0;
         *(const_cast<int**>(&q.elems)) = nullptr;
         q.head = q.tail = 0;
+        latency().resync(queNumber());
+        q.latency().resync(0);
         return *this;
     }
 
     // 拼接队列
     QUEUE& queCat(const QUEUE& q) {
-        int required = queNumber() + q.queNumber();
+        size_t required = queNumber() + q.queNumber();
         if (required >= queSize()) {
-            int newSize = required + 1;  // 保证至少能容纳总和
+            size_t newSize = required + 1;  // 保证至少能容纳总和
             int* newElems = new int[newSize];
-            int cnt = 0;
+            size_t cnt = 0;
             // 复制当前队列元素
             while (head != tail) {
                 newElems[cnt++] = elems[head];
-                head = (head + 1) % max;
+                head = next(head);
             }
             // 复制q的元素
-            int qHead = q.head;
+            size_t qHead = q.head;
             while (qHead != q.tail) {
                 newElems[cnt++] = q.elems[qHead];
                 qHead = (qHead + 1) % q.max;
             }
             delete[] elems;
-            *(const_cast<int*>(&max)) = newSize;
+            *(const_cast<size_t*>(&max)) = newSize;
             *(const_cast<int**>(&elems)) = newElems;
             head = 0;
             tail = cnt;
+            counters().add(QC_ENTER, q.queNumber());
+            counters().peak(cnt);
+            latency().skip(q.queNumber()); // 原有元素次序不变，拼入的元素不采样
         }
         else {
             // 直接拼接
-            int qHead = q.head;
+            size_t qHead = q.head;
             while (qHead != q.tail) {
                 queEnter(q.elems[qHead]);
                 qHead = (qHead + 1) % q.max;
@@ -196,7 +466,7 @@ public:
     // 打印队列内容
     void quePrint(const char* s) const {
         cout << s << ": [";
-        int current = head;
+        size_t current = head;
         while (current != tail) {
             cout << elems[current];
             current = (current + 1) % max;
@@ -208,16 +478,163 @@ public:
     // 清空队列
     void queClear() {
         head = tail = 0;
+        latency().resync(0);
+    }
+
+    // 统计快照，关闭统计时除当前元素个数外均为0
+    QueueStats queStats() const {
+        QueueStats st;
+        counters().fill(st);
+        st.occupancy = queNumber();
+        if (st.highWater < st.occupancy) st.highWater = st.occupancy;
+        return st;
     }
 
+    // 计数清零
+    void queResetStats() { counters().reset(); }
+
+    // 开启停留时间采样，每2^shift个入队元素采一个；开启时已在队中的元素不计
+    void queLatencyOn(unsigned shift = 6) { latency().enable(shift, queNumber()); }
+    void queLatencyOff() { latency().disable(); }
+    // 停留时间直方图，未开启或编译时关闭则为nullptr
+    const LatencyHistogram* queLatency() const { return latency().histogram(); }
+    void queResetLatency() { latency().reset(); }
+
     // 析构函数
     ~QUEUE() {
         delete[] elems;
     }
 };
 
+// 越过32位边界的入队出队测试(约8.6GB，需大内存机器，main以bigtest参数运行)
+void testQueueBig() {
+    const size_t n = ((size_t)1 << 31) + 16;
+    QUEUE q((ptrdiff_t)n + 1);
+    for (size_t i = 0; i < n; ++i) q.queEnter((int)(i * 2654435761u));
+    bool ok = q.queNumber() == n;
+    vector<int> buf(1 << 20);
+    size_t done = 0;
+    while (ok && done < n) {
+        size_t k = buf.size();
+        q.queLeave(k, buf.data());
+        for (size_t j = 0; j < k; ++j) ok = ok && buf[j] == (int)((done + j) * 2654435761u);
+        done += k;
+    }
+    ok = ok && done == n && q.queNumber() == 0;
+    cout << "QueueBig " << n << " elements " << (ok ? "ok" : "FAIL") << endl;
+}
+
+// 容量在运行期才确定，避免编译器把它当常数、把回绕优化成位运算，与实际使用不符
+size_t benchCapacity() {
+    static volatile size_t cap = 1024;
+    return cap;
+}
+
+// 统计开销测试: 与不带计数的同逻辑环形队列对比，以-DQUEUE_STATS=0编译时两者应一致
+void benchQueueStats(size_t rounds) {
+    const size_t cap = benchCapacity(), burst = 700; // burst与容量互质，指针回绕位置不断变化
+    double best[2] = { 1e30, 1e30 };
+    long long sink = 0;
+    for (int rep = 0; rep < 5; ++rep) {
+        // 参照: 裸环形数组
+        {
+            int* buf = new int[cap];
+            size_t h = 0, t = 0;
+            auto t0 = chrono::steady_clock::now();
+            for (size_t r = 0; r < rounds; ++r) {
+                for (size_t i = 0; i < burst; ++i) { buf[t] = (int)i; t = t + 1 == cap ? 0 : t + 1; }
+                for (size_t i = 0; i < burst; ++i) { sink += buf[h]; h = h + 1 == cap ? 0 : h + 1; }
+            }
+            best[0] = min(best[0], chrono::duration<double, nano>(chrono::steady_clock::now() - t0).count());
+            delete[] buf;
+        }
+        {
+            QUEUE q((ptrdiff_t)cap);
+            int e;
+            auto t0 = chrono::steady_clock::now();
+            for (size_t r = 0; r < rounds; ++r) {
+                for (size_t i = 0; i < burst; ++i) q.queEnter((int)i);
+                for (size_t i = 0; i < burst; ++i) { q.queLeave(e); sink += e; }
+            }
+            best[1] = min(best[1], chrono::duration<double, nano>(chrono::steady_clock::now() - t0).count());
+            if (rep == 0) printStats("bench QUEUE: ", q.queStats());
+        }
+    }
+    const double ops = 2.0 * rounds * burst;
+    cout << "QUEUE_STATS=" << QUEUE_STATS << ", sizeof(QUEUE) " << sizeof(QUEUE)
+         << ": raw ring " << best[0] / ops << " ns/op, QUEUE " << best[1] / ops << " ns/op"
+         << " (sink " << sink % 10 << ")" << endl;
+}
+
+// 停留时间测试: 直方图分位数误差在1/16以内，采样只记录被采中的元素
+void testQueueLatency() {
+    LatencyHistogram h;
+    for (unsigned long long v = 1; v <= 100000; ++v) h.record(v);
+    bool ok = h.count() == 100000 && h.max() == 100000;
+    const double ps[] = { 0.5, 0.99, 0.999 };
+    for (double p : ps) {
+        double want = p * 100000, got = (double)h.percentile(p);
+        ok = ok && got >= want && got <= want * (1 + 1.0 / 16);
+    }
+    QUEUE q(100);
+    int e;
+    q.queEnter(1); // 开启前已在队中，不计
+    q.queLatencyOn(2); // 每4个采1个
+    for (int i = 0; i < 40; ++i) q.queEnter(i);
+    for (int i = 0; i < 41; ++i) q.queLeave(e);
+    const LatencyHistogram* lh = q.queLatency();
+#if QUEUE_LATENCY
+    ok = ok && lh != nullptr && lh->count() == 10;
+    q.queEnter(1).queEnter(2);
+    q.queClear(); // 清空后未完成的采样作废
+    for (int i = 0; i < 4; ++i) q.queEnter(i); // 连续4个中恰有1个被采样
+    for (int i = 0; i < 4; ++i) q.queLeave(e);
+    ok = ok && lh->count() == 11;
+#else
+    ok = ok && lh == nullptr;
+#endif
+    cout << "QueueLatency histogram and sampling " << (ok ? "ok" : "FAIL") << endl;
+}
+
+// 停留时间采样开销: 关闭、每64个采1个、每个都采，并给出分位数
+void benchQueueLatency(size_t rounds) {
+    const size_t cap = benchCapacity(), burst = 700;
+    const unsigned shifts[] = { 64, 6, 0 }; // 64表示不开启
+    for (unsigned shift : shifts) {
+        double best = 1e30;
+        long long sink = 0;
+        QUEUE q((ptrdiff_t)cap);
+        if (shift < 64) q.queLatencyOn(shift);
+        for (int rep = 0; rep < 5; ++rep) {
+            int e;
+            auto t0 = chrono::steady_clock::now();
+            for (size_t r = 0; r < rounds; ++r) {
+                for (size_t i = 0; i < burst; ++i) q.queEnter((int)i);
+                for (size_t i = 0; i < burst; ++i) { q.queLeave(e); sink += e; }
+            }
+            best = min(best, chrono::duration<double, nano>(chrono::steady_clock::now() - t0).count());
+        }
+        cout << "latency " << (shift < 64 ? "1/" + to_string(1ULL << shift) : string("off"))
+             << ": " << best / (2.0 * rounds * burst) << " ns/op";
+        if (const LatencyHistogram* h = q.queLatency())
+            cout << ", samples " << h->count() << ", p50 " << h->p50() << " ns, p99 " << h->p99()
+                 << " ns, p999 " << h->p999() << " ns, max " << h->max() << " ns";
+        cout << " (sink " << sink % 10 << ")" << endl;
+    }
+}
+
 // 测试主函数
-int main() {
+int main(int argc, char* argv[]) {
+    if (argc > 1 && strcmp(argv[1], "bigtest") == 0) {
+        testQueueBig();
+        return 0;
+    }
+    if (argc > 1 && strcmp(argv[1], "bench") == 0) {
+        benchQueueStats(20000);
+        benchQueueLatency(20000);
+        return 0;
+    }
+
     // 测试构造函数和入队
     QUEUE q1(5);
     q1.queEnter(1).queEnter(2).queEnter(3);
@@ -246,10 +663,10 @@ int main() {
 
     // 测试批量出队
     int buf[3] = {};
-    int n = 2;
+    size_t n = 2;
     q3.queLeave(n, buf);
     cout << "Dequeued " << n << " elements: ";
-    for (int i = 0; i < n; ++i) cout << buf[i] << " ";
+    for (size_t i = 0; i < n; ++i) cout << buf[i] << " ";
     cout << endl;
 
     // 测试队列拼接
@@ -259,5 +676,13 @@ int main() {
     q4.queCat(q2);
     q4.quePrint("Queue4 after concatenation q2");
 
+    // 测试统计快照
+    printStats("Queue3 stats: ", q3.queStats());
+    printStats("Queue4 stats: ", q4.queStats());
+    q3.queResetStats();
+    printStats("Queue3 stats after reset: ", q3.queStats());
+
+    testQueueLatency();
+
     return 0;
 }
\ No newline at end of file
@@ -1,19 +1,271 @@
 ﻿#include <iostream>
 #include <cstdarg>
 #include <cstring>
+#include <cstddef>
+#include <vector>
+#include <deque>
+#include <memory>
+#include <algorithm>
+#include <chrono>
+#include <queue>
+#include <functional>
+#include <cstdint>
+
+// 统计开关: 编译时定义QUEUE_STATS=0即关闭
+#ifndef QUEUE_STATS
+#define QUEUE_STATS 1
+#endif
+
+// 统计快照
+struct QueueStats {
+    size_t occupancy;   // 当前元素个数
+    size_t highWater;   // 元素个数的历史最大值
+    size_t enters;      // 成功进入的元素数
+    size_t leaves;      // 成功离开的元素数
+    size_t wraps;       // 内部环形数组的首尾指针回绕到0的次数
+    size_t rejected;    // 因已满被拒绝的进入次数
+    size_t batches;     // 批量进入、离开的调用次数
+    size_t batchItems;  // 批量操作涉及的元素总数
+    double avgBatch() const { return batches ? (double)batchItems / batches : 0; }
+};
+
+// MSVC默认只对第一个空基类做空基类优化
+#if defined(_MSC_VER)
+#define QUEUE_EMPTY_BASES __declspec(empty_bases)
+#else
+#define QUEUE_EMPTY_BASES
+#endif
+
+enum QueueCounter { QC_HIGH, QC_ENTER, QC_LEAVE, QC_WRAP, QC_REJECT, QC_BATCH, QC_BATCH_ITEM, QC_COUNT };
+
+// 每个实例的计数器，拷贝、移动时不随内容转移
+template <bool On, class Tag = void>
+class QueueCounters {
+    size_t c[QC_COUNT];
+public:
+    QueueCounters() { reset(); }
+    QueueCounters(const QueueCounters&) { reset(); }
+    QueueCounters& operator=(const QueueCounters&) { return *this; }
+    void add(QueueCounter k, size_t d = 1) { c[k] += d; }
+    void peak(size_t n) { if (n > c[QC_HIGH]) c[QC_HIGH] = n; }
+    void fill(QueueStats& st) const {
+        st.highWater = c[QC_HIGH];
+        st.enters = c[QC_ENTER];
+        st.leaves = c[QC_LEAVE];
+        st.wraps = c[QC_WRAP];
+        st.rejected = c[QC_REJECT];
+        st.batches = c[QC_BATCH];
+        st.batchItems = c[QC_BATCH_ITEM];
+    }
+    void reset() { for (auto& x : c) x = 0; }
+};
+
+// 关闭统计时为空类
+template <class Tag>
+class QueueCounters<false, Tag> {
+public:
+    void add(QueueCounter, size_t = 1) {}
+    void peak(size_t) {}
+    void fill(QueueStats& st) const { st = QueueStats(); }
+    void reset() {}
+};
+
+// 打印统计快照
+inline void printStats(const char* s, const QueueStats& st) {
+    std::cout << s << "occupancy " << st.occupancy << ", high " << st.highWater
+              << ", enters " << st.enters << ", leaves " << st.leaves << ", wraps " << st.wraps
+              << ", rejected " << st.rejected << ", batches " << st.batches
+              << ", avg batch " << st.avgBatch() << std::endl;
+}
+
+// 延迟统计开关: 编译时定义QUEUE_LATENCY=0即关闭
+#ifndef QUEUE_LATENCY
+#define QUEUE_LATENCY 1
+#endif
+
+// 分支提示与禁止内联
+#if defined(__GNUC__)
+#define QUEUE_UNLIKELY(x) __builtin_expect(!!(x), 0)
+#define QUEUE_NOINLINE __attribute__((noinline, cold))
+#elif defined(_MSC_VER)
+#define QUEUE_UNLIKELY(x) (x)
+#define QUEUE_NOINLINE __declspec(noinline)
+#else
+#define QUEUE_UNLIKELY(x) (x)
+#define QUEUE_NOINLINE
+#endif
+
+// 对数分桶直方图(纳秒)，每个2的幂区间分16个子桶，相对误差不超过1/16
+class LatencyHistogram {
+public:
+    static const int SUB_BITS = 4, SUB = 1 << SUB_BITS, BUCKETS = (64 - SUB_BITS + 1) * SUB;
+
+    LatencyHistogram() : buckets(BUCKETS, 0), total(0), maxSeen(0) {}
+
+    void record(unsigned long long ns) {
+        ++buckets[bucketOf(ns)];
+        ++total;
+        if (ns > maxSeen) maxSeen = ns;
+    }
+
+    unsigned long long count() const { return total; }
+    unsigned long long max() const { return maxSeen; }
+
+    // 分位数(p取0~1)，返回所在桶的上界，不超过实际最大值；无样本时为0
+    unsigned long long percentile(double p) const {
+        if (total == 0) return 0;
+        unsigned long long want = (unsigned long long)(p * total);
+        if (want < p * total) ++want;
+        if (want == 0) want = 1;
+        unsigned long long seen = 0;
+        for (int i = 0; i < BUCKETS; ++i) {
+            seen += buckets[i];
+            if (seen >= want) return upperOf(i) < maxSeen ? upperOf(i) : maxSeen;
+        }
+        return maxSeen;
+    }
+    unsigned long long p50() const { return percentile(0.5); }
+    unsigned long long p99() const { return percentile(0.99); }
+    unsigned long long p999() const { return percentile(0.999); }
+
+    void reset() {
+        std::fill(buckets.begin(), buckets.end(), 0ULL);
+        total = maxSeen = 0;
+    }
+
+private:
+    std::vector<unsigned long long> buckets;
+    unsigned long long total, maxSeen;
+
+    // 小于16的值各占一桶；否则取最高位所在的2的幂区间，再取其后4位作子桶
+    static int bucketOf(unsigned long long v) {
+        if (v < SUB) return (int)v;
+        int e = SUB_BITS;
+        while (e < 63 && (v >> (e + 1)) != 0) ++e;
+        return (e - SUB_BITS + 1) * SUB + (int)((v >> (e - SUB_BITS)) & (SUB - 1));
+    }
+    static unsigned long long upperOf(int i) {
+        if (i < SUB) return (unsigned long long)i;
+        const int e = i / SUB + SUB_BITS - 1, shift = e - SUB_BITS;
+        const unsigned long long lower = (unsigned long long)(SUB + i % SUB) << shift;
+        return lower + ((1ULL << shift) - 1);
+    }
+};
+
+// 停留时间采样，默认关闭；每2^shift个入队元素记下(序号, 时刻)，出队序号追上时记入直方图
+template <bool On>
+class QueueLatency {
+    struct State {
+        std::deque<std::pair<unsigned long long, long long>> pending;
+        unsigned long long enterSeq, leaveSeq, nextLeave, mask; // nextLeave为最早一个采样的序号，无采样时为最大值
+        LatencyHistogram hist;
+    };
+    State* st; // 未开启时为nullptr
+
+    static long long now() {
+        return std::chrono::duration_cast<std::chrono::nanoseconds>(
+            std::chrono::steady_clock::now().time_since_epoch()).count();
+    }
+    // 采样路径不内联，只接收State指针，避免队列对象逃逸
+    QUEUE_NOINLINE static void stamp(State* s) {
+        s->pending.emplace_back(s->enterSeq, now());
+        if (s->pending.size() == 1) s->nextLeave = s->enterSeq;
+    }
+    QUEUE_NOINLINE static void finish(State* s) {
+        s->hist.record((unsigned long long)(now() - s->pending.front().second));
+        s->pending.pop_front();
+        s->nextLeave = s->pending.empty() ? ~0ULL : s->pending.front().first;
+    }
+    QUEUE_NOINLINE static void restart(State* s, size_t n) {
+        s->pending.clear();
+        s->nextLeave = ~0ULL;
+        s->enterSeq = s->leaveSeq + n;
+    }
+    QUEUE_NOINLINE static State* create() { return new State(); }
+    QUEUE_NOINLINE static void destroy(State* s) { delete s; }
+public:
+    QueueLatency() : st(nullptr) {}
+    QueueLatency(const QueueLatency&) : st(nullptr) {}
+    QueueLatency& operator=(const QueueLatency&) { return *this; }
+    ~QueueLatency() {
+        if (st) destroy(st);
+    }
+
+    // shift为采样间隔的对数，0表示每个元素都记录；n为队列当前元素个数，它们不参与统计
+    void enable(unsigned shift, size_t n) {
+        if (!st) st = create();
+        st->mask = shift >= 63 ? ~0ULL : (1ULL << shift) - 1;
+        resync(n);
+    }
+    void disable() {
+        if (st) destroy(st);
+        st = nullptr;
+    }
+    bool enabled() const { return st != nullptr; }
+
+    void entered() {
+        if (QUEUE_UNLIKELY(st != nullptr) && (st->enterSeq++ & st->mask) == 0) stamp(st);
+    }
+    void left() {
+        if (QUEUE_UNLIKELY(st != nullptr) && ++st->leaveSeq >= st->nextLeave) finish(st);
+    }
+    // 元素不经entered入队(如整体拼接)，只推进序号
+    void skip(size_t k) {
+        if (st) st->enterSeq += k;
+    }
+    // 内容被整体替换或清空，丢弃未完成的采样，按当前元素个数重新对齐序号
+    void resync(size_t n) {
+        if (st) restart(st, n);
+    }
+    const LatencyHistogram* histogram() const { return st ? &st->hist : nullptr; }
+    void reset() {
+        if (st) st->hist.reset();
+    }
+};
+
+// 关闭延迟统计时为空类
+template <>
+class QueueLatency<false> {
+public:
+    void enable(unsigned, size_t) {}
+    void disable() {}
+    bool enabled() const { return false; }
+    void entered() {}
+    void left() {}
+    void skip(size_t) {}
+    void resync(size_t) {}
+    const LatencyHistogram* histogram() const { return nullptr; }
+    void reset() {}
+};
+
+// 计数与采样作为空基类，编译时关闭后不占空间
+class QUEUE_EMPTY_BASES QUEUE : QueueCounters<QUEUE_STATS != 0>, QueueLatency<QUEUE_LATENCY != 0> {
+    QueueCounters<QUEUE_STATS != 0>& counters() { return *this; }
+    const QueueCounters<QUEUE_STATS != 0>& counters() const { return *this; }
+    QueueLatency<QUEUE_LATENCY != 0>& latency() { return *this; }
+    const QueueLatency<QUEUE_LATENCY != 0>& latency() const { return *this; }
 
-class QUEUE {
     int* const elems;
-    const int max;
-    int head;
-    int tail;
+    const size_t max; // 容量与下标用size_t，可超过2^31
+    size_t head;
+    size_t tail;
+
+    // 容量非正时报错并按1分配(即不能存放元素)，new[]自行检查m*sizeof(int)是否溢出
+    static size_t checkSize(ptrdiff_t m) {
+        if (m > 0) return (size_t)m;
+        std::cerr << "QUEUE size must be positive: " << m << std::endl;
+        return 1;
+    }
+
+    // 环形下标的后继: 用比较代替取模，容量在运行期才知道时免去一次除法
+    size_t next(size_t i) const { return i + 1 == max ? 0 : i + 1; }
 public:
-    QUEUE(int m)
-        : elems(new int[m]), max(m), head(0), tail(0) {}
+    QUEUE(ptrdiff_t m)
+        : elems(new int[checkSize(m)]), max(checkSize(m)), head(0), tail(0) {}
 
     QUEUE(const QUEUE& q)
-        : elems(new int[q.max]), max(q.max), head(q.head), tail(q.tail) {
-        for (int i = 0; i < max; ++i) {
+        : QueueCounters<QUEUE_STATS != 0>(), QueueLatency<QUEUE_LATENCY != 0>(), elems(new int[q.max]), max(q.max), head(q.head), tail(q.tail) {
+        for (size_t i = 0; i < max; ++i) {
             elems[i] = q.elems[i];
         }
     }
@@ -21,30 +273,38 @@ public:
     QUEUE(QUEUE&& q) noexcept
         : elems(q.elems), max(q.max), head(q.head), tail(q.tail) {
         *(int**)&q.elems = nullptr; // hack to modify const pointer
-        *(int*)&q.max = 0;
+        *(size_t*)&q.max = 0;
         q.head = 0;
         q.tail = 0;
+        q.latency().resync(0);
     }
 
-    virtual int size() const {
+    virtual size_t size() const {
         return max;
     }
 
-    virtual int number() const {
-        return (tail - head + max) % max;
+    virtual size_t number() const {
+        return tail >= head ? tail - head : tail + max - head;
     }
 
     virtual QUEUE& enter(int e) {
-        if ((tail + 1) % max == head) {
+        if (next(tail) == head) {
+            counters().add(QC_REJECT);
             std::cerr << "QUEUE is full, cannot enter " << e << std::endl;
             return *this;
         }
         elems[tail] = e;
-        tail = (tail + 1) % max;
+        tail = next(tail);
+        if (tail == 0) counters().add(QC_WRAP);
+        counters().add(QC_ENTER);
+        counters().peak(QUEUE::number());
+        latency().entered();
         return *this;
     }
 
     virtual QUEUE& enter(short n, ...) {
+        counters().add(QC_BATCH);
+        counters().add(QC_BATCH_ITEM, n > 0 ? (size_t)n : 0);
         va_list ap;
         va_start(ap, n);
         for (short i = 0; i < n; ++i) {
@@ -61,16 +321,24 @@ public:
             return *this;
         }
         e = elems[head];
-        head = (head + 1) % max;
+        head = next(head);
+        if (head == 0) counters().add(QC_WRAP);
+        counters().add(QC_LEAVE);
+        latency().left();
         return *this;
     }
 
-    virtual QUEUE& leave(int& n, int* buf) {
-        int cnt = 0;
+    virtual QUEUE& leave(size_t& n, int* buf) {
+        size_t cnt = 0;
         while (cnt < n && head != tail) {
             buf[cnt++] = elems[head];
-            head = (head + 1) % max;
+            head = next(head);
+            if (head == 0) counters().add(QC_WRAP);
+            latency().left();
         }
+        counters().add(QC_LEAVE, cnt);
+        counters().add(QC_BATCH);
+        counters().add(QC_BATCH_ITEM, cnt);
         n = cnt;
         if (cnt == 0) {
             std::cerr << "QUEUE is empty, cannot leave (batch)" << std::endl;
@@ -86,9 +354,10 @@ public:
         }
         head = q.head;
         tail = q.tail;
-        for (int i = 0; i < max; ++i) {
+        for (size_t i = 0; i < max; ++i) {
             elems[i] = q.elems[i];
         }
+        latency().resync(QUEUE::number());
         return *this;
     }
 
@@ -99,19 +368,21 @@ public:
         *(int**)&elems = (int*)q.elems;
         *(int**)&q.elems = tmpElems;
 
-        int tmpMax = *(int*)&max;
-        *(int*)&max = *(int*)&q.max;
-        *(int*)&q.max = tmpMax;
+        size_t tmpMax = *(size_t*)&max;
+        *(size_t*)&max = *(size_t*)&q.max;
+        *(size_t*)&q.max = tmpMax;
 
         std::swap(head, q.head);
         std::swap(tail, q.tail);
+        latency().resync(QUEUE::number());
+        q.latency().resync(q.QUEUE::number());
         return *this;
     }
 
     virtual QUEUE& queCat(const QUEUE& q) {
-        int num = q.number();
-        int idx = q.head;
-        for (int i = 0; i < num; ++i) {
+        size_t num = q.number();
+        size_t idx = q.head;
+        for (size_t i = 0; i < num; ++i) {
             enter(q.elems[idx]);
             idx = (idx + 1) % q.max;
         }
@@ -120,9 +391,9 @@ public:
 
     virtual void print(char* s) const {
         std::cout << s;
-        int cnt = number();
-        int idx = head;
-        for (int i = 0; i < cnt; ++i) {
+        size_t cnt = number();
+        size_t idx = head;
+        for (size_t i = 0; i < cnt; ++i) {
             std::cout << elems[idx] << (i < cnt - 1 ? " " : "");
             idx = (idx + 1) % max;
         }
@@ -131,8 +402,27 @@ public:
 
     virtual void clear() {
         head = tail = 0;
+        latency().resync(0);
     }
 
+    // 统计快照，关闭统计时除当前元素个数外均为0
+    virtual QueueStats stats() const {
+        QueueStats st;
+        counters().fill(st);
+        st.occupancy = number();
+        if (st.highWater < st.occupancy) st.highWater = st.occupancy;
+        return st;
+    }
+
+    // 开启停留时间采样，每2^shift个入队元素采一个；开启时已在队中的元素不计
+    void latencyOn(unsigned shift = 6) { latency().enable(shift, QUEUE::number()); }
+    void latencyOff() { latency().disable(); }
+    // 停留时间直方图，未开启或编译时关闭则为nullptr
+    const LatencyHistogram* latencyHistogram() const { return latency().histogram(); }
+    void resetLatency() { latency().reset(); }
+
+    virtual void resetStats() { counters().reset(); }
+
     virtual ~QUEUE() {
         delete[] elems;
     }
@@ -140,30 +430,21 @@ public:
     friend class STACK;
 };
 
-class STACK : public QUEUE {
+// 栈层面的计数，两个内部队列另有各自的计数；以STACK为标签区别于QUEUE的计数基类
+class QUEUE_EMPTY_BASES STACK : public QUEUE, QueueCounters<QUEUE_STATS != 0, STACK> {
     QUEUE q;
-public:
-    STACK(int m)
-        : QUEUE(m), q(m) {}
-
-    STACK(const STACK& s)
-        : QUEUE(s), q(s.q) {}
 
-    STACK(STACK&& s) noexcept
-        : QUEUE(std::move(s)), q(std::move(s.q)) {}
+    QueueCounters<QUEUE_STATS != 0, STACK>& stackCounters() { return *this; }
+    const QueueCounters<QUEUE_STATS != 0, STACK>& stackCounters() const { return *this; }
 
-    int size() const override {
-        return QUEUE::size() + q.size();
-    }
-
-    int number() const override {
-        return QUEUE::number() + q.number();
-    }
+    // 栈不是先进先出，且内部两个队列会互换内容，停留时间采样不适用
+    void latencyOn(unsigned) = delete;
 
-    STACK& enter(int e) override {
-        if (number() >= size() - 2) {
+    // 入栈、出栈的实际操作，不计数；失败(含内部队列拒收搬移的元素)时返回false
+    bool push(int e) {
+        if (number() + 2 >= size()) {
             std::cerr << "STACK is full, cannot enter " << e << std::endl;
-            return *this;
+            return false;
         }
         // 两个队列都当作队列，模拟栈
         // 选择非空队列作为主队列，空队列作为辅助队列
@@ -178,11 +459,21 @@ public:
         }
         aux->clear();
         aux->QUEUE::enter(e);
-        int cnt = primary->number();
+        bool ok = aux->QUEUE::number() == 1;
+        size_t cnt = primary->number();
         int tmp;
-        for (int i = 0; i < cnt; ++i) {
-            primary->leave(tmp);
-            aux->enter(tmp);
+        for (size_t i = 0; i < cnt; ++i) {
+            // 内部搬移不计入栈的统计
+            if (primary == this) pop(tmp);
+            else primary->leave(tmp);
+            if (aux == this) {
+                ok = push(tmp) && ok;
+            }
+            else {
+                size_t before = aux->QUEUE::number();
+                aux->enter(tmp);
+                ok = ok && aux->QUEUE::number() != before;
+            }
         }
         // swap roles
         if (primary == this) {
@@ -191,17 +482,60 @@ public:
             *(int**)&elems = *(int**)&q.elems;
             *(int**)&q.elems = tmpElems;
 
-            int tmpMax = *(int*)&max;
-            *(int*)&max = *(int*)&q.max;
-            *(int*)&q.max = tmpMax;
+            size_t tmpMax = *(size_t*)&max;
+            *(size_t*)&max = *(size_t*)&q.max;
+            *(size_t*)&q.max = tmpMax;
 
             std::swap(head, q.head);
             std::swap(tail, q.tail);
         }
+        return ok;
+    }
+
+    bool pop(int& e) {
+        if (number() == 0) {
+            std::cerr << "STACK is empty, cannot leave" << std::endl;
+            return false;
+        }
+        if (QUEUE::number() != 0) {
+            QUEUE::leave(e);
+        }
+        else {
+            q.leave(e);
+        }
+        return true;
+    }
+public:
+    STACK(ptrdiff_t m)
+        : QUEUE(m), q(m) {}
+
+    STACK(const STACK& s)
+        : QUEUE(s), QueueCounters<QUEUE_STATS != 0, STACK>(), q(s.q) {}
+
+    STACK(STACK&& s) noexcept
+        : QUEUE(std::move(s)), q(std::move(s.q)) {}
+
+    size_t size() const override {
+        return QUEUE::size() + q.size();
+    }
+
+    size_t number() const override {
+        return QUEUE::number() + q.number();
+    }
+
+    STACK& enter(int e) override {
+        if (push(e)) {
+            stackCounters().add(QC_ENTER);
+            stackCounters().peak(number());
+        }
+        else
+            stackCounters().add(QC_REJECT);
         return *this;
     }
 
     STACK& enter(short n, ...) override {
+        stackCounters().add(QC_BATCH);
+        stackCounters().add(QC_BATCH_ITEM, n > 0 ? (size_t)n : 0);
         va_list ap;
         va_start(ap, n);
         for (short i = 0; i < n; ++i) {
@@ -213,25 +547,18 @@ public:
     }
 
     STACK& leave(int& e) override {
-        if (number() == 0) {
-            std::cerr << "STACK is empty, cannot leave" << std::endl;
-            return *this;
-        }
-        if (QUEUE::number() != 0) {
-            QUEUE::leave(e);
-        }
-        else {
-            q.leave(e);
-        }
+        if (pop(e)) stackCounters().add(QC_LEAVE);
         return *this;
     }
 
-    STACK& leave(int& n, int* buf) override {
-        int cnt = 0;
+    STACK& leave(size_t& n, int* buf) override {
+        size_t cnt = 0;
         while (cnt < n && number() > 0) {
             leave(buf[cnt]);
             ++cnt;
         }
+        stackCounters().add(QC_BATCH);
+        stackCounters().add(QC_BATCH_ITEM, cnt);
         n = cnt;
         if (cnt == 0) {
             std::cerr << "STACK is empty, cannot leave (batch)" << std::endl;
@@ -262,9 +589,9 @@ public:
             primary = this;
         else
             primary = &q;
-        int cnt = primary->number();
-        int idx = primary->head;
-        for (int i = 0; i < cnt; ++i) {
+        size_t cnt = primary->number();
+        size_t idx = primary->head;
+        for (size_t i = 0; i < cnt; ++i) {
             std::cout << primary->elems[idx];
             if (i < cnt - 1) std::cout << " ";
             idx = (idx + 1) % primary->max;
@@ -277,10 +604,379 @@ public:
         q.clear();
     }
 
+    // 栈层面的统计，回绕次数取两个内部队列之和
+    QueueStats stats() const override {
+        QueueStats st;
+        stackCounters().fill(st);
+        st.wraps = QUEUE::stats().wraps + q.stats().wraps;
+        st.occupancy = number();
+        if (st.highWater < st.occupancy) st.highWater = st.occupancy;
+        return st;
+    }
+
+    void resetStats() override {
+        stackCounters().reset();
+        QUEUE::resetStats();
+        q.resetStats();
+    }
+
     ~STACK() {}
 };
 
-int main() {
+// 优先队列: D叉隐式最小堆，接口与QUEUE相同(enter、leave、number、clear)，leave总是取出最小元素
+// 结点i的孩子为D*i+1 ... D*i+D；键值数组整体后移D-1格并按64字节对齐，使每组兄弟正好落在同一缓存行，
+// 下沉时比较D个孩子只需一次缓存行访问，树高也降为log_D(n)
+// 每个元素带一个编号(handle)，可按编号减小键值；元素离开后其编号会被重新分配
+// 编号另存一个平行数组，比较时只读键值数组；Handles为false时不维护编号，不能减小键值
+template <int D = 4, bool Handles = true>
+class PRIQUEUE {
+    static_assert(D >= 2 && 64 % (D * sizeof(int)) == 0, "PRIQUEUE: D siblings must fit one cache line");
+
+    std::unique_ptr<int[]> raw;  // 键值的原始存储，多分配一个缓存行用于对齐
+    int* keys;                   // keys[0]为堆顶
+    std::unique_ptr<size_t[]> ids; // ids[i]为keys[i]的编号
+    const size_t max;
+    size_t cnt;
+    std::vector<size_t> pos;     // 编号 -> 堆中下标，NPOS表示编号空闲
+    std::vector<size_t> freeIds; // 已回收的编号
+    size_t nextId;
+
+    static size_t checkSize(ptrdiff_t m) {
+        if (m > 0) return (size_t)m;
+        std::cerr << "PRIQUEUE size must be positive: " << m << std::endl;
+        return 1;
+    }
+
+    size_t newId() {
+        if (freeIds.empty()) return nextId++;
+        size_t id = freeIds.back();
+        freeIds.pop_back();
+        return id;
+    }
+
+    void place(size_t i, int key, size_t id) {
+        keys[i] = key;
+        if (Handles) {
+            ids[i] = id;
+            pos[id] = i;
+        }
+    }
+
+    void siftUp(size_t i) {
+        int key = keys[i];
+        size_t id = Handles ? ids[i] : 0;
+        while (i > 0) {
+            size_t p = (i - 1) / D;
+            if (keys[p] <= key) break;
+            place(i, keys[p], Handles ? ids[p] : 0);
+            i = p;
+        }
+        place(i, key, id);
+    }
+
+    // 孩子c ... c+D-1中最小者的下标；当前最小值留在寄存器里，避免每次比较都重新按下标取数
+    size_t minChild(size_t c) const {
+        size_t last = c + D <= cnt ? c + D : cnt;
+        size_t m = c;
+        int mk = keys[c];
+        for (size_t j = c + 1; j < last; ++j) {
+            int k = keys[j];
+            m = k < mk ? j : m;
+            mk = k < mk ? k : mk;
+        }
+        return m;
+    }
+
+    void siftDown(size_t i) {
+        int key = keys[i];
+        size_t id = Handles ? ids[i] : 0;
+        for (;;) {
+            size_t c = D * i + 1;
+            if (c >= cnt) break;
+            size_t m = minChild(c);
+            if (keys[m] >= key) break;
+            place(i, keys[m], Handles ? ids[m] : 0);
+            i = m;
+        }
+        place(i, key, id);
+    }
+
+    // 取走堆顶后的调整: 堆尾元素多半要沉到底，先让空位沿最小孩子一路下沉到叶子，再把堆尾元素从那里上浮，
+    // 省去每层与它的比较
+    void refill() {
+        size_t i = 0;
+        for (;;) {
+            size_t c = D * i + 1;
+            if (c >= cnt) break;
+            size_t m = minChild(c);
+            place(i, keys[m], Handles ? ids[m] : 0);
+            i = m;
+        }
+        place(i, keys[cnt], Handles ? ids[cnt] : 0);
+        siftUp(i);
+    }
+public:
+    static const size_t NPOS = (size_t)-1; // 无效编号
+
+    PRIQUEUE(ptrdiff_t m)
+        : max(checkSize(m)), cnt(0), pos(Handles ? max : 0, NPOS), nextId(0) {
+        raw.reset(new int[max + D - 1 + 64 / sizeof(int)]);
+        uintptr_t p = (uintptr_t)raw.get();
+        p = (p + 63) & ~(uintptr_t)63;
+        keys = (int*)p + (D - 1);
+        if (Handles) ids.reset(new size_t[max]);
+    }
+
+    PRIQUEUE(const PRIQUEUE&) = delete;
+    PRIQUEUE& operator=(const PRIQUEUE&) = delete;
+
+    size_t size() const {
+        return max;
+    }
+
+    size_t number() const {
+        return cnt;
+    }
+
+    // 进入并返回该元素的编号，已满或不维护编号时handle为NPOS
+    PRIQUEUE& enter(int e, size_t& handle) {
+        handle = NPOS;
+        if (cnt == max) {
+            std::cerr << "PRIQUEUE is full, cannot enter " << e << std::endl;
+            return *this;
+        }
+        keys[cnt] = e;
+        if (Handles) {
+            handle = newId();
+            ids[cnt] = handle;
+        }
+        siftUp(cnt++);
+        return *this;
+    }
+
+    PRIQUEUE& enter(int e) {
+        size_t handle;
+        return enter(e, handle);
+    }
+
+    PRIQUEUE& enter(short n, ...) {
+        va_list ap;
+        va_start(ap, n);
+        for (short i = 0; i < n; ++i) {
+            int e = va_arg(ap, int);
+            enter(e);
+        }
+        va_end(ap);
+        return *this;
+    }
+
+    // 批量进入: 先整体追加，新元素不少于已有元素时自底向上整体建堆(O(n))，否则逐个上浮
+    // handles非空时依次写入各元素的编号；放不下的部分被拒绝
+    PRIQUEUE& heapify(const int* buf, size_t n, size_t* handles = nullptr) {
+        if (n > max - cnt) {
+            std::cerr << "PRIQUEUE is full, " << n - (max - cnt) << " elements rejected" << std::endl;
+            n = max - cnt;
+        }
+        size_t old = cnt;
+        for (size_t i = 0; i < n; ++i) {
+            size_t id = Handles ? newId() : NPOS;
+            place(cnt++, buf[i], id);
+            if (handles) handles[i] = id;
+        }
+        if (n >= old) {
+            for (size_t i = cnt / D + 1; i-- > 0;) {
+                if (i < cnt) siftDown(i);
+            }
+        }
+        else {
+            for (size_t i = old; i < cnt; ++i) siftUp(i);
+        }
+        return *this;
+    }
+
+    PRIQUEUE& leave(int& e) {
+        if (cnt == 0) {
+            std::cerr << "PRIQUEUE is empty, cannot leave" << std::endl;
+            return *this;
+        }
+        e = keys[0];
+        if (Handles) {
+            pos[ids[0]] = NPOS;
+            freeIds.push_back(ids[0]);
+        }
+        if (--cnt > 0) refill();
+        return *this;
+    }
+
+    PRIQUEUE& leave(size_t& n, int* buf) {
+        size_t k = 0;
+        while (k < n && cnt > 0) {
+            leave(buf[k++]);
+        }
+        n = k;
+        if (k == 0) {
+            std::cerr << "PRIQUEUE is empty, cannot leave (batch)" << std::endl;
+        }
+        return *this;
+    }
+
+    // 堆顶(最小元素)，空时报错并返回0
+    int top() const {
+        if (cnt == 0) {
+            std::cerr << "PRIQUEUE is empty, no top" << std::endl;
+            return 0;
+        }
+        return keys[0];
+    }
+
+    // 按编号减小键值；编号无效或新值更大时报错不改
+    PRIQUEUE& decrease(size_t handle, int e) {
+        static_assert(Handles, "PRIQUEUE: decrease needs Handles");
+        if (handle >= pos.size() || pos[handle] == NPOS) {
+            std::cerr << "PRIQUEUE has no element with handle " << handle << std::endl;
+            return *this;
+        }
+        size_t i = pos[handle];
+        if (e > keys[i]) {
+            std::cerr << "PRIQUEUE cannot decrease " << keys[i] << " to " << e << std::endl;
+            return *this;
+        }
+        keys[i] = e;
+        siftUp(i);
+        return *this;
+    }
+
+    // 按堆数组顺序打印
+    void print(char* s) const {
+        std::cout << s;
+        for (size_t i = 0; i < cnt; ++i) {
+            std::cout << keys[i] << (i < cnt - 1 ? " " : "");
+        }
+        std::cout << std::endl;
+    }
+
+    void clear() {
+        if (Handles) {
+            for (size_t i = 0; i < cnt; ++i) pos[ids[i]] = NPOS;
+        }
+        cnt = 0;
+        freeIds.clear();
+        nextId = 0;
+    }
+};
+
+template <int D, bool Handles>
+const size_t PRIQUEUE<D, Handles>::NPOS;
+
+// 优先队列测试: 乱序进入后应按升序离开；减小键值、批量建堆后同样有序
+void testPriQueue() {
+    PRIQUEUE<4> pq(64);
+    int e, prev;
+    bool ok = true;
+    for (int i = 0; i < 40; ++i) pq.enter((i * 37) % 41);
+    size_t h;
+    pq.enter(100, h);
+    pq.decrease(h, -5);
+    ok = ok && pq.top() == -5 && pq.number() == 41;
+    pq.leave(e);
+    for (prev = e; pq.number() > 0; prev = e) {
+        pq.leave(e);
+        ok = ok && prev <= e;
+    }
+
+    int buf[50];
+    size_t hs[50];
+    for (int i = 0; i < 50; ++i) buf[i] = (i * 13) % 50;
+    PRIQUEUE<8> pq8(50);
+    pq8.enter((short)3, 7, 3, 9);
+    pq8.heapify(buf, 47, hs);
+    pq8.decrease(hs[46], -1);
+    ok = ok && pq8.number() == 50 && pq8.top() == -1;
+    size_t n = 50;
+    pq8.leave(n, buf);
+    ok = ok && n == 50 && std::is_sorted(buf, buf + 50);
+    std::cout << "优先队列: " << (ok ? "ok" : "FAIL") << std::endl;
+}
+
+// 与std::priority_queue对比: n个随机数逐个进入再全部离开，以及批量建堆后全部离开
+template <int D, bool Handles>
+double timePriQueue(const std::vector<int>& v, bool bulk, long long& sum) {
+    PRIQUEUE<D, Handles> pq((ptrdiff_t)v.size());
+    auto t0 = std::chrono::steady_clock::now();
+    if (bulk) pq.heapify(v.data(), v.size());
+    else for (int x : v) pq.enter(x);
+    int e;
+    while (pq.number() > 0) {
+        pq.leave(e);
+        sum += e;
+    }
+    return std::chrono::duration<double, std::nano>(std::chrono::steady_clock::now() - t0).count() / v.size();
+}
+
+void benchPriQueue() {
+    std::cout << "ns/元素; 逐个进入: std::priority_queue, 4叉, 8叉, 4叉带编号; 批量建堆: std, 4叉, 4叉带编号" << std::endl;
+    for (size_t n = 1000; n <= 10000000; n *= 10) {
+        std::vector<int> v(n);
+        unsigned r = 12345;
+        for (size_t i = 0; i < n; ++i) {
+            r = r * 1103515245u + 12345u;
+            v[i] = (int)(r >> 1);
+        }
+        long long sum = 0;
+        int reps = n < 100000 ? 20 : 1;
+        double tStd = 0, tMake = 0, t4 = 0, t8 = 0, t4h = 0, tBulk = 0, tBulkH = 0;
+        for (int k = 0; k < reps; ++k) {
+            auto t0 = std::chrono::steady_clock::now();
+            std::priority_queue<int, std::vector<int>, std::greater<int>> sq;
+            for (int x : v) sq.push(x);
+            while (!sq.empty()) {
+                sum += sq.top();
+                sq.pop();
+            }
+            auto t1 = std::chrono::steady_clock::now();
+            std::priority_queue<int, std::vector<int>, std::greater<int>> mq(std::greater<int>(), v);
+            while (!mq.empty()) {
+                sum += mq.top();
+                mq.pop();
+            }
+            auto t2 = std::chrono::steady_clock::now();
+            tStd += std::chrono::duration<double, std::nano>(t1 - t0).count() / n;
+            tMake += std::chrono::duration<double, std::nano>(t2 - t1).count() / n;
+            t4 += timePriQueue<4, false>(v, false, sum);
+            t8 += timePriQueue<8, false>(v, false, sum);
+            t4h += timePriQueue<4, true>(v, false, sum);
+            tBulk += timePriQueue<4, false>(v, true, sum);
+            tBulkH += timePriQueue<4, true>(v, true, sum);
+        }
+        std::cout << "n=" << n << "; " << tStd / reps << ", " << t4 / reps << ", " << t8 / reps << ", " << t4h / reps
+            << "; " << tMake / reps << ", " << tBulk / reps << ", " << tBulkH / reps << (sum == 42 ? " " : "") << std::endl;
+    }
+}
+
+// 停留时间采样测试: 每个元素都采样，出队后样本数应等于出队数
+void testLatency() {
+    QUEUE q(16);
+    int e;
+    q.latencyOn(0);
+    for (int i = 0; i < 10; ++i) q.enter(i);
+    for (int i = 0; i < 6; ++i) q.leave(e);
+    const LatencyHistogram* h = q.latencyHistogram();
+#if QUEUE_LATENCY
+    bool ok = h != nullptr && h->count() == 6 && h->p50() <= h->p99() && h->p99() <= h->max();
+#else
+    bool ok = h == nullptr;
+#endif
+    std::cout << "停留时间采样: " << (ok ? "ok" : "FAIL");
+    if (h) std::cout << ", p50 " << h->p50() << " ns, p99 " << h->p99() << " ns, p999 " << h->p999() << " ns";
+    std::cout << std::endl;
+}
+
+int main(int argc, char* argv[]) {
+    if (argc > 1 && strcmp(argv[1], "bench") == 0) {
+        benchPriQueue();
+        return 0;
+    }
+
     std::cout << "----栈基本功能测试----" << std::endl;
     STACK s(10); // 容量为18（2*10-2=18），但实际最多存18个元素
     int e;
@@ -300,10 +996,10 @@ int main() {
 
     // 批量出栈
     int buf[10];
-    int n = 3;
+    size_t n = 3;
     s.leave(n, buf);
     std::cout << "批量弹出: ";
-    for (int i = 0; i < n; ++i) std::cout << buf[i] << " ";
+    for (size_t i = 0; i < n; ++i) std::cout << buf[i] << " ";
     std::cout << std::endl;
     s.print((char*)"当前栈: ");
 
@@ -317,6 +1013,15 @@ int main() {
     // 错误处理：压满栈
     for (int i = 0; i < 20; ++i) s.enter(i + 100);
     s.print((char*)"压满后: ");
+    QueueStats ss = s.stats();
+    printStats("栈统计: ", ss);
+    // 清空前进7出4；压满时内部队列拒收的入栈计为被拒，不计为进入
+#if QUEUE_STATS
+    bool statsOk = ss.enters - 7 == ss.occupancy && ss.rejected == 20 - ss.occupancy && ss.leaves == 4;
+#else
+    bool statsOk = ss.enters == 0 && ss.rejected == 0;
+#endif
+    std::cout << "栈统计: " << (statsOk ? "ok" : "FAIL") << std::endl;
 
     // 拷贝构造
     STACK s2 = s;
@@ -336,5 +1041,21 @@ int main() {
     s5 = std::move(s4);
     s5.print((char*)"移动赋值: ");
 
+    // 队列统计
+    QUEUE qs(4);
+    for (int i = 0; i < 10; ++i) qs.enter(i).leave(e); // 反复进出，指针多次回绕
+    qs.enter((short)4, 1, 2, 3, 4); // 第4个被拒
+    QueueStats qst = qs.stats();
+    printStats("队列统计: ", qst);
+#if QUEUE_STATS
+    statsOk = qst.enters == 13 && qst.leaves == 10 && qst.rejected == 1 && qst.occupancy == 3 && qst.batches == 1;
+#else
+    statsOk = qst.enters == 0 && qst.occupancy == 3;
+#endif
+    std::cout << "队列统计: " << (statsOk ? "ok" : "FAIL") << std::endl;
+
+    testLatency();
+    testPriQueue();
+
     return 0;
 }
\ No newline at end of file
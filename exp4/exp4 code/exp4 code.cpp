@@ -2,47 +2,325 @@
 #include <list>
 #include <stdexcept>
 #include <cstring>
+#include <cstddef>
+#include <vector>
+#include <deque>
+#include <memory>
+#include <algorithm>
+#include <chrono>
+#include <climits>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <exception>
+#include <utility>
+#include <atomic>
+#include <cstdint>
+#if defined(__cpp_impl_coroutine)
+#include <coroutine>
+#endif
+
+// 统计开关: 编译时定义QUEUE_STATS=0即关闭
+#ifndef QUEUE_STATS
+#define QUEUE_STATS 1
+#endif
+
+// 统计快照
+struct QueueStats {
+    size_t occupancy;   // 当前元素个数
+    size_t highWater;   // 元素个数的历史最大值
+    size_t enters;      // 成功进入的元素数
+    size_t leaves;      // 成功离开的元素数
+    size_t wraps;       // 内部环形数组的首尾指针回绕到0的次数
+    size_t rejected;    // 因已满被拒绝的进入次数
+    size_t batches;     // 批量进入、离开的调用次数
+    size_t batchItems;  // 批量操作涉及的元素总数
+    double avgBatch() const { return batches ? (double)batchItems / batches : 0; }
+};
+
+// MSVC默认只对第一个空基类做空基类优化
+#if defined(_MSC_VER)
+#define QUEUE_EMPTY_BASES __declspec(empty_bases)
+#else
+#define QUEUE_EMPTY_BASES
+#endif
+
+enum QueueCounter { QC_HIGH, QC_ENTER, QC_LEAVE, QC_WRAP, QC_REJECT, QC_BATCH, QC_BATCH_ITEM, QC_COUNT };
+
+// 每个实例的计数器，拷贝、移动时不随内容转移
+template <bool On, class Tag = void>
+class QueueCounters {
+    size_t c[QC_COUNT];
+public:
+    QueueCounters() { reset(); }
+    QueueCounters(const QueueCounters&) { reset(); }
+    QueueCounters& operator=(const QueueCounters&) { return *this; }
+    void add(QueueCounter k, size_t d = 1) { c[k] += d; }
+    void peak(size_t n) { if (n > c[QC_HIGH]) c[QC_HIGH] = n; }
+    void fill(QueueStats& st) const {
+        st.highWater = c[QC_HIGH];
+        st.enters = c[QC_ENTER];
+        st.leaves = c[QC_LEAVE];
+        st.wraps = c[QC_WRAP];
+        st.rejected = c[QC_REJECT];
+        st.batches = c[QC_BATCH];
+        st.batchItems = c[QC_BATCH_ITEM];
+    }
+    void reset() { for (auto& x : c) x = 0; }
+};
+
+// 关闭统计时为空类
+template <class Tag>
+class QueueCounters<false, Tag> {
+public:
+    void add(QueueCounter, size_t = 1) {}
+    void peak(size_t) {}
+    void fill(QueueStats& st) const { st = QueueStats(); }
+    void reset() {}
+};
+
+// 打印统计快照
+inline void printStats(const char* s, const QueueStats& st) {
+    std::cout << s << "occupancy " << st.occupancy << ", high " << st.highWater
+              << ", enters " << st.enters << ", leaves " << st.leaves << ", wraps " << st.wraps
+              << ", rejected " << st.rejected << ", batches " << st.batches
+              << ", avg batch " << st.avgBatch() << std::endl;
+}
+
+// 延迟统计开关: 编译时定义QUEUE_LATENCY=0即关闭
+#ifndef QUEUE_LATENCY
+#define QUEUE_LATENCY 1
+#endif
+
+// 分支提示与禁止内联
+#if defined(__GNUC__)
+#define QUEUE_UNLIKELY(x) __builtin_expect(!!(x), 0)
+#define QUEUE_NOINLINE __attribute__((noinline, cold))
+#elif defined(_MSC_VER)
+#define QUEUE_UNLIKELY(x) (x)
+#define QUEUE_NOINLINE __declspec(noinline)
+#else
+#define QUEUE_UNLIKELY(x) (x)
+#define QUEUE_NOINLINE
+#endif
+
+// 对数分桶直方图(纳秒)，每个2的幂区间分16个子桶，相对误差不超过1/16
+class LatencyHistogram {
+public:
+    static const int SUB_BITS = 4, SUB = 1 << SUB_BITS, BUCKETS = (64 - SUB_BITS + 1) * SUB;
+
+    LatencyHistogram() : buckets(BUCKETS, 0), total(0), maxSeen(0) {}
+
+    void record(unsigned long long ns) {
+        ++buckets[bucketOf(ns)];
+        ++total;
+        if (ns > maxSeen) maxSeen = ns;
+    }
+
+    unsigned long long count() const { return total; }
+    unsigned long long max() const { return maxSeen; }
+
+    // 分位数(p取0~1)，返回所在桶的上界，不超过实际最大值；无样本时为0
+    unsigned long long percentile(double p) const {
+        if (total == 0) return 0;
+        unsigned long long want = (unsigned long long)(p * total);
+        if (want < p * total) ++want;
+        if (want == 0) want = 1;
+        unsigned long long seen = 0;
+        for (int i = 0; i < BUCKETS; ++i) {
+            seen += buckets[i];
+            if (seen >= want) return upperOf(i) < maxSeen ? upperOf(i) : maxSeen;
+        }
+        return maxSeen;
+    }
+    unsigned long long p50() const { return percentile(0.5); }
+    unsigned long long p99() const { return percentile(0.99); }
+    unsigned long long p999() const { return percentile(0.999); }
+
+    void reset() {
+        std::fill(buckets.begin(), buckets.end(), 0ULL);
+        total = maxSeen = 0;
+    }
+
+private:
+    std::vector<unsigned long long> buckets;
+    unsigned long long total, maxSeen;
+
+    // 小于16的值各占一桶；否则取最高位所在的2的幂区间，再取其后4位作子桶
+    static int bucketOf(unsigned long long v) {
+        if (v < SUB) return (int)v;
+        int e = SUB_BITS;
+        while (e < 63 && (v >> (e + 1)) != 0) ++e;
+        return (e - SUB_BITS + 1) * SUB + (int)((v >> (e - SUB_BITS)) & (SUB - 1));
+    }
+    static unsigned long long upperOf(int i) {
+        if (i < SUB) return (unsigned long long)i;
+        const int e = i / SUB + SUB_BITS - 1, shift = e - SUB_BITS;
+        const unsigned long long lower = (unsigned long long)(SUB + i % SUB) << shift;
+        return lower + ((1ULL << shift) - 1);
+    }
+};
+
+// 停留时间采样，默认关闭；每2^shift个入队元素记下(序号, 时刻)，出队序号追上时记入直方图
+template <bool On>
+class QueueLatency {
+    struct State {
+        std::deque<std::pair<unsigned long long, long long>> pending;
+        unsigned long long enterSeq, leaveSeq, nextLeave, mask; // nextLeave为最早一个采样的序号，无采样时为最大值
+        LatencyHistogram hist;
+    };
+    State* st; // 未开启时为nullptr
+
+    static long long now() {
+        return std::chrono::duration_cast<std::chrono::nanoseconds>(
+            std::chrono::steady_clock::now().time_since_epoch()).count();
+    }
+    // 采样路径不内联，只接收State指针，避免队列对象逃逸
+    QUEUE_NOINLINE static void stamp(State* s) {
+        s->pending.emplace_back(s->enterSeq, now());
+        if (s->pending.size() == 1) s->nextLeave = s->enterSeq;
+    }
+    QUEUE_NOINLINE static void finish(State* s) {
+        s->hist.record((unsigned long long)(now() - s->pending.front().second));
+        s->pending.pop_front();
+        s->nextLeave = s->pending.empty() ? ~0ULL : s->pending.front().first;
+    }
+    QUEUE_NOINLINE static void restart(State* s, size_t n) {
+        s->pending.clear();
+        s->nextLeave = ~0ULL;
+        s->enterSeq = s->leaveSeq + n;
+    }
+    QUEUE_NOINLINE static State* create() { return new State(); }
+    QUEUE_NOINLINE static void destroy(State* s) { delete s; }
+public:
+    QueueLatency() : st(nullptr) {}
+    QueueLatency(const QueueLatency&) : st(nullptr) {}
+    QueueLatency& operator=(const QueueLatency&) { return *this; }
+    ~QueueLatency() {
+        if (st) destroy(st);
+    }
+
+    // shift为采样间隔的对数，0表示每个元素都记录；n为队列当前元素个数，它们不参与统计
+    void enable(unsigned shift, size_t n) {
+        if (!st) st = create();
+        st->mask = shift >= 63 ? ~0ULL : (1ULL << shift) - 1;
+        resync(n);
+    }
+    void disable() {
+        if (st) destroy(st);
+        st = nullptr;
+    }
+    bool enabled() const { return st != nullptr; }
+
+    void entered() {
+        if (QUEUE_UNLIKELY(st != nullptr) && (st->enterSeq++ & st->mask) == 0) stamp(st);
+    }
+    void left() {
+        if (QUEUE_UNLIKELY(st != nullptr) && ++st->leaveSeq >= st->nextLeave) finish(st);
+    }
+    // 元素不经entered入队(如整体拼接)，只推进序号
+    void skip(size_t k) {
+        if (st) st->enterSeq += k;
+    }
+    // 内容被整体替换或清空，丢弃未完成的采样，按当前元素个数重新对齐序号
+    void resync(size_t n) {
+        if (st) restart(st, n);
+    }
+    const LatencyHistogram* histogram() const { return st ? &st->hist : nullptr; }
+    void reset() {
+        if (st) st->hist.reset();
+    }
+};
+
+// 关闭延迟统计时为空类
+template <>
+class QueueLatency<false> {
+public:
+    void enable(unsigned, size_t) {}
+    void disable() {}
+    bool enabled() const { return false; }
+    void entered() {}
+    void left() {}
+    void skip(size_t) {}
+    void resync(size_t) {}
+    const LatencyHistogram* histogram() const { return nullptr; }
+    void reset() {}
+};
+
+// 计数与采样作为空基类，编译时关闭后不占空间
+class QUEUE_EMPTY_BASES QUEUE : QueueCounters<QUEUE_STATS != 0>, QueueLatency<QUEUE_LATENCY != 0> {
+    QueueCounters<QUEUE_STATS != 0>& counters() { return *this; }
+    const QueueCounters<QUEUE_STATS != 0>& counters() const { return *this; }
+    QueueLatency<QUEUE_LATENCY != 0>& latency() { return *this; }
+    const QueueLatency<QUEUE_LATENCY != 0>& latency() const { return *this; }
 
-class QUEUE {
     int* const elems;
-    const int max;
-    int head;
-    int tail;
+    const size_t max; // 容量与下标用size_t，可超过2^31
+    size_t head;
+    size_t tail;
+
+    // new[]自行检查m*sizeof(int)是否溢出
+    static size_t checkSize(ptrdiff_t m) {
+        if (m <= 0)
+            throw std::invalid_argument("QUEUE size must be positive");
+        return (size_t)m;
+    }
+
+    // 环形下标的后继: 用比较代替取模，容量在运行期才知道时免去一次除法
+    size_t next(size_t i) const { return i + 1 == max ? 0 : i + 1; }
 public:
-    QUEUE(int m)
-        : elems(new int[m]), max(m), head(0), tail(0) {}
+    QUEUE(ptrdiff_t m)
+        : elems(new int[checkSize(m)]), max((size_t)m), head(0), tail(0) {}
 
     QUEUE(const QUEUE& q)
-        : elems(new int[q.max]), max(q.max), head(q.head), tail(q.tail) {
-        for (int i = 0; i < max; ++i) elems[i] = q.elems[i];
+        : QueueCounters<QUEUE_STATS != 0>(), QueueLatency<QUEUE_LATENCY != 0>(), elems(new int[q.max]), max(q.max), head(q.head), tail(q.tail) {
+        for (size_t i = 0; i < max; ++i) elems[i] = q.elems[i];
     }
 
     QUEUE(QUEUE&& q) noexcept
         : elems(q.elems), max(q.max), head(q.head), tail(q.tail) {
         *(int**)&q.elems = nullptr;
-        *(int*)&q.max = 0;
+        *(size_t*)&q.max = 0;
         q.head = 0;
         q.tail = 0;
+        q.latency().resync(0);
     }
 
-    virtual int size() const noexcept {
+    virtual size_t size() const noexcept {
         return max;
     }
 
-    virtual operator int() const noexcept {
-        return (tail - head + max) % max;
+    // 元素个数
+    virtual size_t number() const noexcept {
+        return tail >= head ? tail - head : tail + max - head;
+    }
+
+    // 元素个数超出int时抛异常，大队列应改用number()
+    virtual operator int() const {
+        size_t n = number();
+        if (n > INT_MAX)
+            throw std::overflow_error("QUEUE element count exceeds int");
+        return (int)n;
     }
 
     virtual QUEUE& operator<<(int e) {
-        if ((tail + 1) % max == head)
+        if (next(tail) == head) {
+            counters().add(QC_REJECT);
             throw std::overflow_error("QUEUE is full, cannot enter element");
+        }
         elems[tail] = e;
-        tail = (tail + 1) % max;
+        tail = next(tail);
+        if (tail == 0) counters().add(QC_WRAP);
+        counters().add(QC_ENTER);
+        counters().peak(QUEUE::number());
+        latency().entered();
         return *this;
     }
 
     virtual QUEUE& operator<<(std::list<int>& s) {
         if (s.size() == 0) return *this;
+        counters().add(QC_BATCH);
+        counters().add(QC_BATCH_ITEM, s.size());
         for (int v : s) {
             *this << v;
         }
@@ -53,15 +331,20 @@ public:
         if (head == tail)
             throw std::underflow_error("QUEUE is empty, cannot leave element");
         e = elems[head];
-        head = (head + 1) % max;
+        head = next(head);
+        if (head == 0) counters().add(QC_WRAP);
+        counters().add(QC_LEAVE);
+        latency().left();
         return *this;
     }
 
     virtual QUEUE& operator>>(std::list<int>& s) {
         size_t cnt = s.size();
         if (cnt == 0) cnt = 5;
-        else cnt = std::min(cnt, (size_t)(int(*this)));
+        else cnt = std::min(cnt, number());
         s.clear();
+        counters().add(QC_BATCH);
+        counters().add(QC_BATCH_ITEM, cnt);
         int tmp;
         for (size_t i = 0; i < cnt; ++i) {
             if (head == tail)
@@ -78,7 +361,8 @@ public:
             throw std::runtime_error("QUEUE assignment failed: size mismatch");
         head = q.head;
         tail = q.tail;
-        for (int i = 0; i < max; ++i) elems[i] = q.elems[i];
+        for (size_t i = 0; i < max; ++i) elems[i] = q.elems[i];
+        latency().resync(QUEUE::number());
         return *this;
     }
 
@@ -88,20 +372,22 @@ public:
         *(int**)&elems = (int*)q.elems;
         *(int**)&q.elems = tmpElems;
 
-        int tmpMax = *(int*)&max;
-        *(int*)&max = *(int*)&q.max;
-        *(int*)&q.max = tmpMax;
+        size_t tmpMax = *(size_t*)&max;
+        *(size_t*)&max = *(size_t*)&q.max;
+        *(size_t*)&q.max = tmpMax;
 
         std::swap(head, q.head);
         std::swap(tail, q.tail);
+        latency().resync(QUEUE::number());
+        q.latency().resync(q.QUEUE::number());
         return *this;
     }
 
     virtual void print(char* s) const {
         std::cout << s;
-        int cnt = int(*this);
-        int idx = head;
-        for (int i = 0; i < cnt; ++i) {
+        size_t cnt = number();
+        size_t idx = head;
+        for (size_t i = 0; i < cnt; ++i) {
             std::cout << elems[idx] << (i < cnt - 1 ? " " : "");
             idx = (idx + 1) % max;
         }
@@ -110,8 +396,27 @@ public:
 
     virtual void clear() noexcept {
         head = tail = 0;
+        latency().resync(0);
+    }
+
+    // 统计快照，关闭统计时除当前元素个数外均为0
+    virtual QueueStats stats() const noexcept {
+        QueueStats st;
+        counters().fill(st);
+        st.occupancy = number();
+        if (st.highWater < st.occupancy) st.highWater = st.occupancy;
+        return st;
     }
 
+    // 开启停留时间采样，每2^shift个入队元素采一个；开启时已在队中的元素不计
+    void latencyOn(unsigned shift = 6) { latency().enable(shift, QUEUE::number()); }
+    void latencyOff() { latency().disable(); }
+    // 停留时间直方图，未开启或编译时关闭则为nullptr
+    const LatencyHistogram* latencyHistogram() const { return latency().histogram(); }
+    void resetLatency() { latency().reset(); }
+
+    virtual void resetStats() noexcept { counters().reset(); }
+
     virtual ~QUEUE() noexcept {
         delete[] elems;
     }
@@ -120,31 +425,22 @@ public:
 };
 
 
-class STACK : public QUEUE {
+// 栈层面的计数，两个内部队列另有各自的计数；以STACK为标签区别于QUEUE的计数基类
+class QUEUE_EMPTY_BASES STACK : public QUEUE, QueueCounters<QUEUE_STATS != 0, STACK> {
     QUEUE q;
-public:
-    STACK(int m)
-        : QUEUE(m), q(m) {}
 
-    STACK(const STACK& s)
-        : QUEUE(s), q(s.q) {}
+    QueueCounters<QUEUE_STATS != 0, STACK>& stackCounters() { return *this; }
+    const QueueCounters<QUEUE_STATS != 0, STACK>& stackCounters() const { return *this; }
 
-    STACK(STACK&& s) noexcept
-        : QUEUE(std::move(s)), q(std::move(s.q)) {}
-
-    int size() const noexcept override {
-        return QUEUE::size() + q.size();
-    }
-
-    operator int() const noexcept override {
-        return QUEUE::operator int() + q.operator int();
-    }
+    // 栈不是先进先出，且内部两个队列会互换内容，停留时间采样不适用
+    void latencyOn(unsigned) = delete;
 
-    STACK& operator<<(int e) override {
-        if (int(*this) >= size() - 2)
+    // 入栈、出栈的实际操作，由调用者计数；栈满或内部队列拒收搬移的元素时抛overflow_error
+    void push(int e) {
+        if (number() + 2 >= size())
             throw std::overflow_error("STACK is full, cannot enter element");
         QUEUE* primary, * aux;
-        if (QUEUE::operator int() != 0) {
+        if (QUEUE::number() != 0) {
             primary = this;
             aux = &q;
         }
@@ -154,10 +450,12 @@ public:
         }
         aux->clear();
         aux->QUEUE::operator<<(e); // 强制调用基类方法，避免递归
-        int cnt = int(*primary);
+        size_t cnt = primary->number();
         int tmp;
-        for (int i = 0; i < cnt; ++i) {
-            *primary >> tmp;
+        for (size_t i = 0; i < cnt; ++i) {
+            // 内部搬移不计入栈的统计
+            if (primary == this) pop(tmp);
+            else *primary >> tmp;
             aux->QUEUE::operator<<(tmp); // 同理
         }
         // swap roles
@@ -166,18 +464,58 @@ public:
             *(int**)&elems = *(int**)&q.elems;
             *(int**)&q.elems = tmpElems;
 
-            int tmpMax = *(int*)&max;
-            *(int*)&max = *(int*)&q.max;
-            *(int*)&q.max = tmpMax;
+            size_t tmpMax = *(size_t*)&max;
+            *(size_t*)&max = *(size_t*)&q.max;
+            *(size_t*)&q.max = tmpMax;
 
             std::swap(head, q.head);
             std::swap(tail, q.tail);
         }
+    }
+
+    void pop(int& e) {
+        if (number() == 0)
+            throw std::underflow_error("STACK is empty, cannot leave element");
+        if (QUEUE::number() != 0)
+            QUEUE::operator>>(e);
+        else
+            q.operator>>(e);
+    }
+public:
+    STACK(ptrdiff_t m)
+        : QUEUE(m), q(m) {}
+
+    STACK(const STACK& s)
+        : QUEUE(s), QueueCounters<QUEUE_STATS != 0, STACK>(), q(s.q) {}
+
+    STACK(STACK&& s) noexcept
+        : QUEUE(std::move(s)), q(std::move(s.q)) {}
+
+    size_t size() const noexcept override {
+        return QUEUE::size() + q.size();
+    }
+
+    size_t number() const noexcept override {
+        return QUEUE::number() + q.number();
+    }
+
+    STACK& operator<<(int e) override {
+        try {
+            push(e);
+        }
+        catch (const std::overflow_error&) {
+            stackCounters().add(QC_REJECT);
+            throw;
+        }
+        stackCounters().add(QC_ENTER);
+        stackCounters().peak(number());
         return *this;
     }
 
     STACK& operator<<(std::list<int>& s) override {
         if (s.size() == 0) return *this;
+        stackCounters().add(QC_BATCH);
+        stackCounters().add(QC_BATCH_ITEM, s.size());
         for (int v : s) {
             *this << v;
         }
@@ -185,23 +523,21 @@ public:
     }
 
     STACK& operator>>(int& e) override {
-        if (int(*this) == 0)
-            throw std::underflow_error("STACK is empty, cannot leave element");
-        if (QUEUE::operator int() != 0)
-            QUEUE::operator>>(e);
-        else
-            q.operator>>(e);
+        pop(e);
+        stackCounters().add(QC_LEAVE);
         return *this;
     }
 
     STACK& operator>>(std::list<int>& s) override {
         size_t cnt = s.size();
         if (cnt == 0) cnt = 5;
-        else cnt = std::min(cnt, (size_t)(int(*this)));
+        else cnt = std::min(cnt, number());
         s.clear();
+        stackCounters().add(QC_BATCH);
+        stackCounters().add(QC_BATCH_ITEM, cnt);
         int tmp;
         for (size_t i = 0; i < cnt; ++i) {
-            if (int(*this) == 0)
+            if (number() == 0)
                 throw std::underflow_error("STACK is empty, cannot leave element (batch)");
             (*this) >> tmp;
             s.push_back(tmp);
@@ -226,13 +562,13 @@ public:
     void print(char* s)const override {
         std::cout << s;
         const QUEUE* primary;
-        if (QUEUE::operator int() != 0)
+        if (QUEUE::number() != 0)
             primary = this;
         else
             primary = &q;
-        int cnt = int(*primary);
-        int idx = primary->head;
-        for (int i = 0; i < cnt; ++i) {
+        size_t cnt = primary->number();
+        size_t idx = primary->head;
+        for (size_t i = 0; i < cnt; ++i) {
             std::cout << primary->elems[idx];
             if (i < cnt - 1) std::cout << " ";
             idx = (idx + 1) % primary->max;
@@ -245,12 +581,629 @@ public:
         q.clear();
     }
 
+    // 栈层面的统计，回绕次数取两个内部队列之和
+    QueueStats stats() const noexcept override {
+        QueueStats st;
+        stackCounters().fill(st);
+        st.wraps = QUEUE::stats().wraps + q.stats().wraps;
+        st.occupancy = number();
+        if (st.highWater < st.occupancy) st.highWater = st.occupancy;
+        return st;
+    }
+
+    void resetStats() noexcept override {
+        stackCounters().reset();
+        QUEUE::resetStats();
+        q.resetStats();
+    }
+
     ~STACK() noexcept {}
 };
 
+// 变长字节环形队列: 记录带长度前缀，生产者reserve(len)得到可写区间，原地写好后commit()；
+// 消费者peek()得到可读区间，原地读完后release()。消息不必先序列化到别处再排队下标，省一次拷贝和分配
+// 每条记录为8字节头(长度) + 内容，按8字节对齐，内容可直接当结构体用；
+// 尾部剩余空间放不下一条记录时写一个填充头，整条记录从数组开头写起，因此单条记录内容总是连续的
+// 容量取2的幂，首尾用只增不减的字节偏移；一个生产者线程与一个消费者线程可以同时使用，
+// 各自只写自己的偏移(release)、读对方的偏移(acquire)，不加锁
+class BYTEQUEUE {
+public:
+    struct Span {
+        unsigned char* data; // 为nullptr表示没有可用区间
+        size_t len;
+    };
+private:
+    struct Header {
+        uint32_t len; // 内容字节数，PAD表示填充到数组末尾
+        uint32_t unused;
+    };
+    static const uint32_t PAD = 0xFFFFFFFFu;
+    static const size_t ALIGN = sizeof(Header);
+
+    std::unique_ptr<uint64_t[]> raw; // 按8字节对齐的存储
+    unsigned char* const buf;
+    const size_t cap;
+    const size_t mask;
+    std::atomic<size_t> head;   // 消费者写
+    std::atomic<size_t> tail;   // 生产者写
+    std::atomic<size_t> enters; // 生产者写，已提交的记录数
+    std::atomic<size_t> leaves; // 消费者写，已释放的记录数
+    size_t reserved;            // 生产者私有: 已预留记录的起始偏移，NONE表示没有
+    size_t peeked;              // 消费者私有: 已取得记录之后的偏移，NONE表示没有
+    static const size_t NONE = (size_t)-1;
+
+    // 不小于m的2的幂，至少64字节
+    static size_t checkSize(ptrdiff_t m) {
+        if (m <= 0)
+            throw std::invalid_argument("BYTEQUEUE size must be positive");
+        if ((size_t)m > ((size_t)1 << (sizeof(size_t) * 8 - 2)))
+            throw std::length_error("BYTEQUEUE size too large");
+        size_t c = 64;
+        while (c < (size_t)m) c <<= 1;
+        return c;
+    }
+
+    static size_t recordSize(size_t len) {
+        return (sizeof(Header) + len + ALIGN - 1) & ~(ALIGN - 1);
+    }
+
+    Header* header(size_t off) const {
+        return (Header*)(buf + (off & mask));
+    }
+public:
+    explicit BYTEQUEUE(ptrdiff_t m)
+        : raw(new uint64_t[checkSize(m) / sizeof(uint64_t)]), buf((unsigned char*)raw.get()),
+          cap(checkSize(m)), mask(cap - 1), head(0), tail(0), enters(0), leaves(0),
+          reserved(NONE), peeked(NONE) {}
+
+    BYTEQUEUE(const BYTEQUEUE&) = delete;
+    BYTEQUEUE& operator=(const BYTEQUEUE&) = delete;
+
+    // 容量(字节)
+    size_t size() const noexcept {
+        return cap;
+    }
+
+    // 单条记录内容的最大长度；超过一半容量的记录在某些位置即使队列为空也放不下，长度还须放得进32位的头
+    size_t maxRecord() const noexcept {
+        size_t m = cap / 2 - sizeof(Header);
+        return m < PAD ? m : PAD - 1;
+    }
+
+    // 已提交未释放的记录数；先读消费者的计数，保证差值不为负
+    size_t number() const noexcept {
+        size_t l = leaves.load(std::memory_order_acquire);
+        return enters.load(std::memory_order_acquire) - l;
+    }
+
+    // 已占用的字节数(含头和填充)
+    size_t bytes() const noexcept {
+        size_t h = head.load(std::memory_order_acquire);
+        return tail.load(std::memory_order_acquire) - h;
+    }
+
+    // 预留len字节的可写区间，空间不足时返回data为nullptr的区间；上一次预留未提交时再预留会覆盖它
+    Span tryReserve(size_t len) {
+        if (len > maxRecord())
+            throw std::length_error("BYTEQUEUE record too long");
+        size_t t = tail.load(std::memory_order_relaxed);
+        size_t h = head.load(std::memory_order_acquire);
+        size_t avail = cap - (t - h);
+        size_t need = recordSize(len);
+        size_t toEnd = cap - (t & mask);
+        if (need > toEnd) {
+            // 尾部放不下，先占住尾部作填充，提交时随记录一起发布
+            if (toEnd + need > avail) return Span{ nullptr, 0 };
+            header(t)->len = PAD;
+            t += toEnd;
+        }
+        else if (need > avail) {
+            return Span{ nullptr, 0 };
+        }
+        header(t)->len = (uint32_t)len;
+        reserved = t;
+        return Span{ buf + (t & mask) + sizeof(Header), len };
+    }
+
+    Span reserve(size_t len) {
+        Span s = tryReserve(len);
+        if (!s.data)
+            throw std::overflow_error("BYTEQUEUE is full, cannot reserve record");
+        return s;
+    }
+
+    // 提交预留的记录，used小于预留长度时只提交前used字节
+    void commit(size_t used) {
+        if (reserved == NONE)
+            throw std::logic_error("BYTEQUEUE commit without reserve");
+        Header* hd = header(reserved);
+        if (used > hd->len)
+            throw std::length_error("BYTEQUEUE commit longer than reserved");
+        hd->len = (uint32_t)used;
+        tail.store(reserved + recordSize(used), std::memory_order_release);
+        enters.store(enters.load(std::memory_order_relaxed) + 1, std::memory_order_release);
+        reserved = NONE;
+    }
+
+    void commit() {
+        if (reserved == NONE)
+            throw std::logic_error("BYTEQUEUE commit without reserve");
+        commit(header(reserved)->len);
+    }
+
+    // 取得最早一条记录的可读区间，队列为空时返回data为nullptr的区间；重复调用得到同一条记录
+    Span tryPeek() {
+        size_t h = head.load(std::memory_order_relaxed);
+        if (h == tail.load(std::memory_order_acquire)) return Span{ nullptr, 0 };
+        Header* hd = header(h);
+        if (hd->len == PAD) {
+            // 填充之后必有记录，二者同时发布
+            h += cap - (h & mask);
+            head.store(h, std::memory_order_release);
+            hd = header(h);
+        }
+        peeked = h + recordSize(hd->len);
+        return Span{ (unsigned char*)hd + sizeof(Header), hd->len };
+    }
+
+    Span peek() {
+        Span s = tryPeek();
+        if (!s.data)
+            throw std::underflow_error("BYTEQUEUE is empty, cannot peek record");
+        return s;
+    }
+
+    // 释放peek得到的记录，其空间可被生产者重用
+    void release() {
+        if (peeked == NONE)
+            throw std::logic_error("BYTEQUEUE release without peek");
+        head.store(peeked, std::memory_order_release);
+        leaves.store(leaves.load(std::memory_order_relaxed) + 1, std::memory_order_release);
+        peeked = NONE;
+    }
+
+    // 清空，只能在没有其他线程使用时调用
+    void clear() noexcept {
+        head.store(0);
+        tail.store(0);
+        enters.store(0);
+        leaves.store(0);
+        reserved = peeked = NONE;
+    }
+};
+
+
+#if defined(__cpp_impl_coroutine)
+// 单线程执行器: 就绪的协程按先进先出依次恢复，run()直到没有就绪协程为止
+// 协程间交接只是把句柄放进就绪队列，在同一线程上恢复，不经内核的上下文切换
+class CoExecutor {
+    std::deque<std::coroutine_handle<>> ready;
+    std::exception_ptr error;
+public:
+    void schedule(std::coroutine_handle<> h) { ready.push_back(h); }
+
+    // 任务中未捕获的异常在run()中重新抛出
+    void fail(std::exception_ptr e) noexcept {
+        if (!error) error = e;
+    }
+    void run() {
+        while (!ready.empty()) {
+            std::coroutine_handle<> h = ready.front();
+            ready.pop_front();
+            h.resume();
+            if (error) std::rethrow_exception(std::exchange(error, nullptr));
+        }
+    }
+    size_t pending() const noexcept { return ready.size(); }
+};
+
+// 由执行器运行的协程任务: 创建后先挂起，spawn时交给执行器；执行完毕自行销毁
+class CoTask {
+public:
+    struct promise_type {
+        CoExecutor* ex = nullptr;
+        CoTask get_return_object() { return CoTask(std::coroutine_handle<promise_type>::from_promise(*this)); }
+        std::suspend_always initial_suspend() noexcept { return {}; }
+        std::suspend_never final_suspend() noexcept { return {}; }
+        void return_void() noexcept {}
+        void unhandled_exception() noexcept {
+            if (ex) ex->fail(std::current_exception());
+        }
+    };
+
+    CoTask(CoTask&& t) noexcept : h(std::exchange(t.h, nullptr)) {}
+    CoTask(const CoTask&) = delete;
+    CoTask& operator=(const CoTask&) = delete;
+    ~CoTask() {
+        if (h) h.destroy();
+    }
+
+    void spawn(CoExecutor& ex) {
+        if (!h) throw std::runtime_error("CoTask already spawned");
+        h.promise().ex = &ex;
+        ex.schedule(std::exchange(h, nullptr));
+    }
+private:
+    explicit CoTask(std::coroutine_handle<promise_type> h_) : h(h_) {}
+    std::coroutine_handle<promise_type> h;
+};
+
+// 可等待队列: co_await pop()在队空时挂起，co_await push(x)在队满时挂起
+// 元素存于QUEUE中，挂起的协程按先来先服务排队；有协程在等元素时push直接交给它，
+// 出队腾出空位时把等待最久的push放进队列，被满足的协程交给执行器恢复
+// 只能在执行器所在的线程中使用
+class CoQUEUE {
+    struct Waiter {
+        std::coroutine_handle<> h;
+        int value;
+    };
+    QUEUE q;
+    CoExecutor& ex;
+    std::deque<Waiter*> poppers, pushers;
+
+    bool full() const noexcept { return q.number() + 1 >= q.size(); }
+
+    bool tryPush(int e) {
+        if (!poppers.empty()) {
+            Waiter* w = poppers.front();
+            poppers.pop_front();
+            w->value = e;
+            ex.schedule(w->h);
+            return true;
+        }
+        if (full()) return false;
+        q << e;
+        return true;
+    }
+    bool tryPop(int& e) {
+        if (q.number() == 0) return false;
+        q >> e;
+        if (!pushers.empty()) {
+            Waiter* w = pushers.front();
+            pushers.pop_front();
+            q << w->value;
+            ex.schedule(w->h);
+        }
+        return true;
+    }
+public:
+    struct PushAwaiter {
+        CoQUEUE& cq;
+        Waiter w;
+        bool await_ready() { return cq.tryPush(w.value); }
+        void await_suspend(std::coroutine_handle<> h) {
+            w.h = h;
+            cq.pushers.push_back(&w);
+        }
+        void await_resume() const noexcept {}
+    };
+    struct PopAwaiter {
+        CoQUEUE& cq;
+        Waiter w;
+        bool await_ready() { return cq.tryPop(w.value); }
+        void await_suspend(std::coroutine_handle<> h) {
+            w.h = h;
+            cq.poppers.push_back(&w);
+        }
+        int await_resume() const noexcept { return w.value; }
+    };
+
+    // m为最多容纳的元素个数
+    CoQUEUE(CoExecutor& ex_, ptrdiff_t m) : q(m + 1), ex(ex_) {}
+    CoQUEUE(const CoQUEUE&) = delete;
+    CoQUEUE& operator=(const CoQUEUE&) = delete;
+
+    PushAwaiter push(int e) { return { *this, { nullptr, e } }; }
+    PopAwaiter pop() { return { *this, { nullptr, 0 } }; }
+
+    size_t size() const noexcept { return q.size() - 1; }
+    size_t number() const noexcept { return q.number(); }
+    size_t waitingPush() const noexcept { return pushers.size(); }
+    size_t waitingPop() const noexcept { return poppers.size(); }
+};
+
+// 协程队列测试: 容量4的队列，生产者比消费者快，应在队满时挂起且元素次序不变
+CoTask coProduce(CoQUEUE& q, int n, size_t& maxWaiting) {
+    for (int i = 0; i < n; ++i) {
+        co_await q.push(i);
+        maxWaiting = std::max(maxWaiting, q.number());
+    }
+    co_await q.push(-1);
+}
+
+CoTask coConsume(CoQUEUE& q, std::vector<int>& out, bool& sawFull) {
+    for (;;) {
+        int v = co_await q.pop();
+        if (v < 0) break;
+        out.push_back(v);
+        if (q.waitingPush() > 0) sawFull = true;
+    }
+}
+
+CoTask coThrow(CoQUEUE& q) {
+    co_await q.pop();
+    throw std::runtime_error("error inside coroutine");
+}
+
+CoTask coPush(CoQUEUE& q, int v) {
+    co_await q.push(v);
+}
+
+void testCoQueue() {
+    CoExecutor ex;
+    CoQUEUE q(ex, 4);
+    std::vector<int> out;
+    size_t maxNumber = 0;
+    bool sawFull = false;
+    coProduce(q, 100, maxNumber).spawn(ex);
+    coConsume(q, out, sawFull).spawn(ex);
+    ex.run();
+    bool ok = out.size() == 100 && maxNumber == 4 && sawFull && q.number() == 0;
+    for (int i = 0; ok && i < 100; ++i) ok = out[i] == i;
+
+    // 任务中的异常由run()抛出
+    bool thrown = false;
+    coThrow(q).spawn(ex);
+    ex.run(); // 队空，挂起
+    coPush(q, 1).spawn(ex); // 交给等待的协程
+    try {
+        ex.run();
+    }
+    catch (const std::runtime_error&) {
+        thrown = true;
+    }
+    std::cout << "协程队列: " << (ok && thrown ? "ok" : "FAIL") << std::endl;
+}
+
+// 乒乓测试: 一个元素在两方之间往返n次，比较协程交接与线程交接(互斥锁+条件变量)的单程耗时
+CoTask coPing(CoQUEUE& a, CoQUEUE& b, int n) {
+    for (int i = 0; i < n; ++i) {
+        co_await a.push(i);
+        co_await b.pop();
+    }
+}
+
+CoTask coPong(CoQUEUE& a, CoQUEUE& b, int n) {
+    for (int i = 0; i < n; ++i) {
+        int v = co_await a.pop();
+        co_await b.push(v + 1);
+    }
+}
+
+// 线程间的阻塞队列，作为对照
+class BlockingQUEUE {
+    QUEUE q;
+    std::mutex m;
+    std::condition_variable notEmpty, notFull;
+public:
+    explicit BlockingQUEUE(ptrdiff_t m_) : q(m_ + 1) {}
+    void push(int e) {
+        std::unique_lock<std::mutex> lock(m);
+        notFull.wait(lock, [&] { return q.number() + 1 < q.size(); });
+        q << e;
+        notEmpty.notify_one();
+    }
+    int pop() {
+        std::unique_lock<std::mutex> lock(m);
+        notEmpty.wait(lock, [&] { return q.number() > 0; });
+        int e;
+        q >> e;
+        notFull.notify_one();
+        return e;
+    }
+};
+
+void benchPingPong(int n) {
+    CoExecutor ex;
+    CoQUEUE a(ex, 1), b(ex, 1);
+    auto t0 = std::chrono::steady_clock::now();
+    coPing(a, b, n).spawn(ex);
+    coPong(a, b, n).spawn(ex);
+    ex.run();
+    double co = std::chrono::duration<double, std::nano>(std::chrono::steady_clock::now() - t0).count();
+
+    BlockingQUEUE ta(1), tb(1);
+    const int m = std::max(1, n / 10); // 线程交接慢得多，少做一些
+    t0 = std::chrono::steady_clock::now();
+    std::thread pong([&] {
+        for (int i = 0; i < m; ++i) tb.push(ta.pop() + 1);
+    });
+    for (int i = 0; i < m; ++i) {
+        ta.push(i);
+        tb.pop();
+    }
+    pong.join();
+    double th = std::chrono::duration<double, std::nano>(std::chrono::steady_clock::now() - t0).count();
+
+    std::cout << "ping-pong: coroutine " << co / (2.0 * n) << " ns/handoff, thread "
+              << th / (2.0 * m) << " ns/handoff (" << std::thread::hardware_concurrency() << " cores)" << std::endl;
+}
+#endif
+
+// 字节队列测试: 变长记录原地写、原地读，多次回绕后内容与顺序不变；另起一个线程作生产者再核对一遍
+void testByteQueue() {
+    BYTEQUEUE bq(256);
+    bool ok = bq.size() == 256 && bq.maxRecord() == 120;
+    unsigned next = 0, expect = 0;
+    for (int round = 0; round < 200; ++round) {
+        // 长度0~100不等，逼出尾部填充
+        for (;;) {
+            size_t len = (next * 37) % 101;
+            BYTEQUEUE::Span w = bq.tryReserve(len + 8);
+            if (!w.data) break;
+            for (size_t i = 0; i < len; ++i) w.data[i] = (unsigned char)(next + i);
+            bq.commit(len); // 少提交8字节
+            ++next;
+        }
+        while (bq.number() > 1) {
+            BYTEQUEUE::Span r = bq.peek();
+            size_t len = (expect * 37) % 101;
+            ok = ok && r.len == len && ((uintptr_t)r.data & 7) == 0;
+            for (size_t i = 0; i < r.len; ++i) ok = ok && r.data[i] == (unsigned char)(expect + i);
+            bq.release();
+            ++expect;
+        }
+    }
+    try {
+        bq.reserve(121);
+        ok = false;
+    }
+    catch (const std::length_error&) {}
+    try {
+        bq.release();
+        ok = false;
+    }
+    catch (const std::logic_error&) {}
+    bq.clear();
+    ok = ok && bq.number() == 0 && bq.bytes() == 0 && bq.tryPeek().data == nullptr;
+
+    const unsigned n = 100000;
+    BYTEQUEUE tq(4096);
+    std::thread producer([&] {
+        for (unsigned k = 0; k < n; ++k) {
+            size_t len = sizeof(unsigned) * (1 + k % 16);
+            BYTEQUEUE::Span w;
+            while (!(w = tq.tryReserve(len)).data) std::this_thread::yield();
+            for (size_t i = 0; i < len / sizeof(unsigned); ++i) ((unsigned*)w.data)[i] = k + (unsigned)i;
+            tq.commit();
+        }
+    });
+    for (unsigned k = 0; k < n; ++k) {
+        BYTEQUEUE::Span r;
+        while (!(r = tq.tryPeek()).data) std::this_thread::yield();
+        ok = ok && r.len == sizeof(unsigned) * (1 + k % 16);
+        for (size_t i = 0; i < r.len / sizeof(unsigned); ++i) ok = ok && ((unsigned*)r.data)[i] == k + (unsigned)i;
+        tq.release();
+    }
+    producer.join();
+    ok = ok && tq.number() == 0;
+    std::cout << "字节队列: " << (ok ? "ok" : "FAIL") << ", 单线程 " << next << " 条, 双线程 " << n << " 条" << std::endl;
+}
+
+// 字节队列与"消息序列化到单独分配的缓冲区、队列里排下标"的做法对比，单线程，每次成批写入再读出
+void benchByteQueue() {
+    const size_t total = (size_t)1 << 28; // 每种长度搬运的总字节数
+    const size_t batch = 32;
+    for (size_t len = 16; len <= 4096; len *= 4) {
+        size_t n = total / len;
+        std::vector<unsigned char> msg(len, 1);
+        size_t sum = 0;
+
+        BYTEQUEUE bq((ptrdiff_t)(batch * (len + 16) * 2));
+        auto t0 = std::chrono::steady_clock::now();
+        for (size_t k = 0; k < n; k += batch) {
+            for (size_t i = 0; i < batch; ++i) {
+                BYTEQUEUE::Span w = bq.reserve(len);
+                memcpy(w.data, msg.data(), len);
+                w.data[0] = (unsigned char)i;
+                bq.commit();
+            }
+            for (size_t i = 0; i < batch; ++i) {
+                BYTEQUEUE::Span r = bq.peek();
+                sum += r.data[0] + r.data[r.len - 1];
+                bq.release();
+            }
+        }
+        double tRing = std::chrono::duration<double, std::nano>(std::chrono::steady_clock::now() - t0).count();
+
+        QUEUE idx((ptrdiff_t)batch + 1);
+        std::vector<std::unique_ptr<unsigned char[]>> side(batch);
+        t0 = std::chrono::steady_clock::now();
+        for (size_t k = 0; k < n; k += batch) {
+            for (size_t i = 0; i < batch; ++i) {
+                side[i].reset(new unsigned char[len]);
+                memcpy(side[i].get(), msg.data(), len);
+                side[i][0] = (unsigned char)i;
+                idx << (int)i;
+            }
+            for (size_t i = 0; i < batch; ++i) {
+                int j;
+                idx >> j;
+                std::unique_ptr<unsigned char[]> p = std::move(side[j]);
+                sum += p[0] + p[len - 1];
+            }
+        }
+        double tSide = std::chrono::duration<double, std::nano>(std::chrono::steady_clock::now() - t0).count();
+
+        std::cout << "message " << len << " B: BYTEQUEUE " << tRing / n << " ns/msg, side buffer + QUEUE "
+                  << tSide / n << " ns/msg" << (sum == 42 ? " " : "") << std::endl;
+    }
+}
+
+// 统计测试
+void testStats() {
+    int e;
+    QUEUE qs(4);
+    for (int i = 0; i < 10; ++i) qs << i >> e; // 反复进出，指针多次回绕
+    try {
+        std::list<int> in = { 1, 2, 3, 4 };
+        qs << in; // 第4个被拒
+    }
+    catch (const std::exception& ex) {
+        std::cout << "异常捕获: " << ex.what() << std::endl;
+    }
+    QueueStats qst = qs.stats();
+    printStats("队列统计: ", qst);
+
+    STACK st(4);
+    std::list<int> in = { 1, 2, 3 }, out(2);
+    st << in >> e;
+    st >> out;
+    try {
+        st << 4 << 5 << 6 << 7 << 8; // 内部队列先满，7被拒并抛异常
+    }
+    catch (const std::exception& ex) {
+        std::cout << "异常捕获: " << ex.what() << std::endl;
+    }
+    QueueStats sst = st.stats();
+    printStats("栈统计: ", sst);
+    st.resetStats();
+    QueueStats zst = st.stats();
+    printStats("栈统计清零后: ", zst);
+
+#if QUEUE_STATS
+    bool ok = qst.enters == 13 && qst.leaves == 10 && qst.rejected == 1 && qst.occupancy == 3 && qst.batches == 1
+        && sst.enters == 6 && sst.leaves == 3 && sst.rejected == 1 && sst.occupancy == 3 && sst.batches == 2
+        && zst.enters == 0 && zst.rejected == 0 && zst.occupancy == 3;
+#else
+    bool ok = qst.enters == 0 && sst.rejected == 0 && sst.occupancy == 3;
+#endif
+    std::cout << "统计: " << (ok ? "ok" : "FAIL") << std::endl;
+}
+
+// 停留时间采样测试: 每个元素都采样，出队后样本数应等于出队数
+void testLatency() {
+    QUEUE q(16);
+    int e;
+    q.latencyOn(0);
+    for (int i = 0; i < 10; ++i) q << i;
+    for (int i = 0; i < 6; ++i) q >> e;
+    const LatencyHistogram* h = q.latencyHistogram();
+#if QUEUE_LATENCY
+    bool ok = h != nullptr && h->count() == 6 && h->p50() <= h->p99() && h->p99() <= h->max();
+#else
+    bool ok = h == nullptr;
+#endif
+    std::cout << "停留时间采样: " << (ok ? "ok" : "FAIL");
+    if (h) std::cout << ", p50 " << h->p50() << " ns, p99 " << h->p99() << " ns, p999 " << h->p999() << " ns";
+    std::cout << std::endl;
+}
 
 // 测试代码
-int main() {
+int main(int argc, char* argv[]) {
+    if (argc > 1 && strcmp(argv[1], "bench") == 0) {
+#if defined(__cpp_impl_coroutine)
+        benchPingPong(1000000);
+#endif
+        benchByteQueue();
+        return 0;
+    }
+#if defined(__cpp_impl_coroutine)
+    testCoQueue();
+#endif
+    testStats();
+    testLatency();
+    testByteQueue();
     try {
         std::cout << "----栈基本功能测试----" << std::endl;
         STACK s(10); // 容量为18（2*10-2=18），但实际最多存18个元素
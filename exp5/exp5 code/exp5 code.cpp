@@ -1,88 +1,844 @@
 ﻿#define _CRT_SECURE_NO_WARNINGS
+#ifdef _WIN32
+#define NOMINMAX
+#include <windows.h>
+#else
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+#if defined(__AVX__)
+#include <immintrin.h>
+#define MAT_SIMD_AVX
+#elif defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#include <emmintrin.h>
+#define MAT_SIMD_SSE2
+#endif
 #include <iostream>
 #include <iomanip>
 #include <exception>
 #include <typeinfo>
 #include <string.h>
+#include <cmath>
+#include <chrono>
+#include <algorithm>
+#include <vector>
+#include <utility>
+#include <initializer_list>
+#include <memory>
+#include <new>
+#include <type_traits>
+#include <cstdint>
+#include <climits>
+#include <limits>
+#include <cstdio>
+#include <stdexcept>
+#include <charconv>
+#include <string>
+#include <thread>
+#include <ostream>
+#include <sstream>
+#include <functional>
+#include <mutex>
+#include <future>
+#include <condition_variable>
+#include <atomic>
 using namespace std;
 
+// 性能剖析: 编译时定义MAT_PROFILE=1才启用，否则MAT_PROF_SCOPE为空语句，参数也不求值
+// 启用后乘法、转置各为一个区间，按运算名与规模档(最大维度向上取2的幂)累计墙钟时间；
+// Linux上另经perf_event_open读取周期、指令、L1数据缓存读缺失、末级缓存缺失、数据TLB读缺失，
+// 据此可判断运算受限于计算(IPC高)、缓存(L1/LLC缺失多)还是TLB(dTLB缺失多)
+#ifndef MAT_PROFILE
+#define MAT_PROFILE 0
+#endif
+
+#if MAT_PROFILE
+#if defined(__linux__)
+#include <linux/perf_event.h>
+#include <sys/ioctl.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+#endif
+#include <map>
+
+// 一个区间内的计数增量；ev[k]在该事件不可用时无意义
+struct MatProfCounts {
+    enum { CYCLES, INSTRUCTIONS, L1D_MISS, LLC_MISS, DTLB_MISS, EVENTS };
+    unsigned long long ns = 0, ev[EVENTS] = {};
+};
+
+// 本线程的硬件计数器组: 首次使用时打开，一次read读出组内全部计数
+// 非Linux、内核不支持或权限不足(perf_event_paranoid)时打不开的事件标为不可用，只计时
+class MatProfHw {
+    int fd[MatProfCounts::EVENTS];
+    int slot[MatProfCounts::EVENTS]; // 事件在组读结果中的位置，-1为不可用
+    int leader = -1, opened = 0;
+public:
+    MatProfHw() {
+        std::fill_n(fd, (int)MatProfCounts::EVENTS, -1);
+        std::fill_n(slot, (int)MatProfCounts::EVENTS, -1);
+#if defined(__linux__)
+        const auto cache = [](unsigned long long id) {
+            return id | ((unsigned long long)PERF_COUNT_HW_CACHE_OP_READ << 8) | ((unsigned long long)PERF_COUNT_HW_CACHE_RESULT_MISS << 16);
+        };
+        const std::pair<unsigned, unsigned long long> events[MatProfCounts::EVENTS] = {
+            { PERF_TYPE_HARDWARE, PERF_COUNT_HW_CPU_CYCLES },
+            { PERF_TYPE_HARDWARE, PERF_COUNT_HW_INSTRUCTIONS },
+            { PERF_TYPE_HW_CACHE, cache(PERF_COUNT_HW_CACHE_L1D) },
+            { PERF_TYPE_HARDWARE, PERF_COUNT_HW_CACHE_MISSES },
+            { PERF_TYPE_HW_CACHE, cache(PERF_COUNT_HW_CACHE_DTLB) },
+        };
+        for (int k = 0; k < MatProfCounts::EVENTS; ++k) {
+            perf_event_attr a;
+            memset(&a, 0, sizeof(a));
+            a.size = sizeof(a);
+            a.type = events[k].first;
+            a.config = events[k].second;
+            a.exclude_kernel = 1;
+            a.exclude_hv = 1;
+            a.read_format = PERF_FORMAT_GROUP;
+            fd[k] = (int)syscall(SYS_perf_event_open, &a, 0, -1, leader, 0);
+            if (fd[k] < 0) continue;
+            if (leader < 0) leader = fd[k];
+            slot[k] = opened++;
+        }
+#endif
+    }
+    ~MatProfHw() {
+#if defined(__linux__)
+        for (int f : fd)
+            if (f >= 0) close(f);
+#endif
+    }
+    MatProfHw(const MatProfHw&) = delete;
+    MatProfHw& operator=(const MatProfHw&) = delete;
+
+    static MatProfHw& local() {
+        thread_local MatProfHw hw;
+        return hw;
+    }
+    bool available(int k) const { return slot[k] >= 0; }
+    bool any() const { return opened > 0; }
+    // 读出当前计数，不可用的事件置0
+    void read(unsigned long long (&ev)[MatProfCounts::EVENTS]) const {
+        std::fill_n(ev, (int)MatProfCounts::EVENTS, 0ULL);
+#if defined(__linux__)
+        if (leader < 0) return;
+        unsigned long long buf[1 + MatProfCounts::EVENTS];
+        if (::read(leader, buf, sizeof(buf)) < (ssize_t)sizeof(unsigned long long)) return;
+        for (int k = 0; k < MatProfCounts::EVENTS; ++k)
+            if (slot[k] >= 0 && (unsigned long long)slot[k] < buf[0]) ev[k] = buf[1 + slot[k]];
+#endif
+    }
+};
+
+// 全进程的区间汇总表: 键为(运算名, 规模档)
+class MatProfiler {
+public:
+    struct Entry {
+        unsigned long long calls = 0;
+        MatProfCounts sum;
+    };
+    static MatProfiler& instance() {
+        static MatProfiler p;
+        return p;
+    }
+    void add(const char* op, long long sizeClass, const MatProfCounts& c) {
+        std::lock_guard<std::mutex> lock(m);
+        Entry& e = table[{ op, sizeClass }];
+        ++e.calls;
+        e.sum.ns += c.ns;
+        for (int k = 0; k < MatProfCounts::EVENTS; ++k) e.sum.ev[k] += c.ev[k];
+    }
+    Entry find(const char* op, long long sizeClass) const {
+        std::lock_guard<std::mutex> lock(m);
+        auto it = table.find({ op, sizeClass });
+        return it == table.end() ? Entry() : it->second;
+    }
+    void reset() {
+        std::lock_guard<std::mutex> lock(m);
+        table.clear();
+    }
+    // 以JSON输出: 各区间的调用次数、总时间与各事件总数，不可用的事件为null
+    void dumpJson(std::ostream& os) const {
+        static const char* names[MatProfCounts::EVENTS] = { "cycles", "instructions", "l1d_misses", "llc_misses", "dtlb_misses" };
+        const MatProfHw& hw = MatProfHw::local();
+        std::lock_guard<std::mutex> lock(m);
+        os << "{\"enabled\": true, \"hw\": " << (hw.any() ? "true" : "false") << ", \"regions\": [";
+        bool first = true;
+        for (const auto& kv : table) {
+            const Entry& e = kv.second;
+            os << (first ? "" : ",") << "\n  {\"op\": \"" << kv.first.first << "\", \"size\": " << kv.first.second
+               << ", \"calls\": " << e.calls << ", \"ns\": " << e.sum.ns;
+            for (int k = 0; k < MatProfCounts::EVENTS; ++k) {
+                os << ", \"" << names[k] << "\": ";
+                if (hw.available(k)) os << e.sum.ev[k];
+                else os << "null";
+            }
+            if (hw.available(MatProfCounts::CYCLES) && hw.available(MatProfCounts::INSTRUCTIONS) && e.sum.ev[MatProfCounts::CYCLES])
+                os << ", \"ipc\": " << (double)e.sum.ev[MatProfCounts::INSTRUCTIONS] / e.sum.ev[MatProfCounts::CYCLES];
+            os << "}";
+            first = false;
+        }
+        os << "\n]}" << std::endl;
+    }
+private:
+    mutable std::mutex m;
+    std::map<std::pair<std::string, long long>, Entry> table;
+};
+
+// 规模档: 不小于n的最小2的幂
+inline long long matProfClass(long long n) {
+    long long c = 1;
+    while (c < n) c <<= 1;
+    return c;
+}
+
+// 剖析区间: 构造时记下时刻与计数，析构时把增量计入汇总表
+class MatProfScope {
+    const char* op;
+    long long cls;
+    std::chrono::steady_clock::time_point t0;
+    unsigned long long ev0[MatProfCounts::EVENTS];
+public:
+    MatProfScope(const char* op_, long long size) : op(op_), cls(matProfClass(size)) {
+        MatProfHw::local().read(ev0);
+        t0 = std::chrono::steady_clock::now();
+    }
+    ~MatProfScope() {
+        MatProfCounts c;
+        c.ns = (unsigned long long)std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now() - t0).count();
+        MatProfHw::local().read(c.ev);
+        for (int k = 0; k < MatProfCounts::EVENTS; ++k) c.ev[k] -= ev0[k];
+        MatProfiler::instance().add(op, cls, c);
+    }
+    MatProfScope(const MatProfScope&) = delete;
+    MatProfScope& operator=(const MatProfScope&) = delete;
+};
+
+#define MAT_PROF_SCOPE(op, size) MatProfScope matProfScope_(op, size)
+inline void matProfileDump(std::ostream& os) { MatProfiler::instance().dumpJson(os); }
+inline void matProfileReset() { MatProfiler::instance().reset(); }
+#else
+#define MAT_PROF_SCOPE(op, size) ((void)0)
+inline void matProfileDump(std::ostream& os) { os << "{\"enabled\": false}" << std::endl; }
+inline void matProfileReset() {}
+#endif
+
+// R、C为0时是运行期维度的动态矩阵，否则为编译期维度的定长矩阵
+template <typename T, int R = 0, int C = 0>
+class MAT;
+
 template <typename T>
-class MAT {
+class TransView;
+
+// 矩阵视图: 不拥有元素，描述某矩阵的一块(首地址、行数、列数、行跨度)
+// T为const时只读；取子块不复制元素，可直接参与MAT的各算术运算
+template <typename T>
+class MatView {
+    using E = typename std::remove_const<T>::type;
+    T* p;
+    int r, c, ld;
+public:
+    MatView(T* p_, int r_, int c_, int ld_) : p(p_), r(r_), c(c_), ld(ld_) {}
+
+    // 可写视图可隐式转为只读视图
+    template <typename U, typename = typename std::enable_if<std::is_same<const U, T>::value && !std::is_same<U, T>::value>::type>
+    MatView(const MatView<U>& v) : p(v.data()), r(v.rows()), c(v.cols()), ld(v.stride()) {}
+
+    // 下标运算符: 取r行首地址，越界抛异常
+    T* operator[](int row) const {
+        if (row < 0 || row >= r)
+            throw std::out_of_range("行下标越界");
+        return p + (size_t)row * ld;
+    }
+
+    // 子块: 自(i0, j0)起h行w列
+    MatView block(int i0, int j0, int h, int w) const {
+        if (i0 < 0 || j0 < 0 || h < 0 || w < 0 || i0 + h > r || j0 + w > c)
+            throw std::out_of_range("子块越界");
+        return MatView(p + (size_t)i0 * ld + j0, h, w, ld);
+    }
+    // 自i0起n行
+    MatView rowRange(int i0, int n) const { return block(i0, 0, n, c); }
+    // 自j0起n列
+    MatView colRange(int j0, int n) const { return block(0, j0, r, n); }
+
+    MAT<E> operator+(MatView<const E> a) const;
+    MAT<E> operator-(MatView<const E> a) const;
+    MAT<E> operator*(MatView<const E> a) const;
+    MAT<E> operator*(TransView<E> a) const;
+    // 转置: 只做标记，不复制元素
+    TransView<E> operator~() const;
+
+    // 就地运算，只用于可写视图；写回所视矩阵
+    MatView& operator+=(MatView<const E> a);
+    MatView& operator-=(MatView<const E> a);
+    MatView& operator*=(MatView<const E> a);
+    // 把a的元素复制进本视图(视图间的=仍是重新绑定)
+    MatView& assign(MatView<const E> a);
+
+    T* data() const noexcept { return p; }
+    // 行跨度(元素个数)
+    int stride() const { return ld; }
+    // 行数
+    int rows() const { return r; }
+    // 列数
+    int cols() const { return c; }
+};
+
+// 转置视图: 只记录被转置的矩阵，不复制元素；乘法核按原矩阵的存储顺序读取它
+template <typename T>
+class TransView {
+    MatView<const T> v;
+public:
+    explicit TransView(MatView<const T> v_) : v(v_) {}
+
+    // 元素(i, j)，即原矩阵的(j, i)
+    T operator()(int i, int j) const { return v[j][i]; }
+    // 被转置的原矩阵
+    MatView<const T> base() const { return v; }
+    // 再次转置即原矩阵
+    MatView<const T> operator~() const { return v; }
+
+    MAT<T> operator*(MatView<const T> a) const;
+    MAT<T> operator*(TransView a) const;
+    // 其余运算先实际转置，再按MAT计算
+    MAT<T> operator+(MatView<const T> a) const;
+    MAT<T> operator-(MatView<const T> a) const;
+    MAT<T> operator*(T s) const;
+    char* print(char* s) const;
+
+    // 行数
+    int rows() const { return v.cols(); }
+    // 列数
+    int cols() const { return v.rows(); }
+};
+
+// C的一行按beta缩放: beta为0时直接清零(不读取原值，避免NaN/Inf传播)，为1时不动
+template <typename T>
+inline void matScaleRow(T* ci, int n, T beta) {
+    if (beta == T(0)) for (int j = 0; j < n; ++j) ci[j] = 0;
+    else if (beta != T(1)) for (int j = 0; j < n; ++j) ci[j] *= beta;
+}
+
+// 点积结果写回: beta为0时不读取原值
+template <typename T>
+inline void matStoreDot(T& cij, T alpha, T sum, T beta) {
+    cij = beta == T(0) ? alpha * sum : alpha * sum + beta * cij;
+}
+
+// 普通乘法核: C(m×n) = alpha·A(m×k)·B(k×n) + beta·C，各操作数带行跨度，按i-k-j顺序连续访问B和C的行
+template <typename T>
+void matKernel(const T* A, int lda, const T* B, int ldb, T* C, int ldc, int m, int k, int n,
+               T alpha = 1, T beta = 0) {
+    for (int i = 0; i < m; ++i) {
+        T* ci = C + (size_t)i * ldc;
+        matScaleRow(ci, n, beta);
+        const T* ai = A + (size_t)i * lda;
+        int p = 0;
+        // 一次并入B的4行，C的行每4项只读写一遍
+        for (; p + 4 <= k; p += 4) {
+            const T a0 = alpha * ai[p], a1 = alpha * ai[p + 1], a2 = alpha * ai[p + 2], a3 = alpha * ai[p + 3];
+            const T* b0 = B + (size_t)p * ldb;
+            const T* b1 = b0 + ldb;
+            const T* b2 = b1 + ldb;
+            const T* b3 = b2 + ldb;
+            for (int j = 0; j < n; ++j) ci[j] += a0 * b0[j] + a1 * b1[j] + a2 * b2[j] + a3 * b3[j];
+        }
+        for (; p < k; ++p) {
+            const T aip = alpha * ai[p];
+            const T* bp = B + (size_t)p * ldb;
+            for (int j = 0; j < n; ++j) ci[j] += aip * bp[j];
+        }
+    }
+}
+
+// A * ~B: B按n×k存放，C[i][j]为A第i行与B第j行的点积，两者均按行连续读取
+template <typename T>
+void matKernelNT(const T* A, int lda, const T* B, int ldb, T* C, int ldc, int m, int k, int n,
+                 T alpha = 1, T beta = 0) {
+    for (int i = 0; i < m; ++i) {
+        const T* ai = A + (size_t)i * lda;
+        T* ci = C + (size_t)i * ldc;
+        for (int j = 0; j < n; ++j) {
+            const T* bj = B + (size_t)j * ldb;
+            // 4路独立累加，打破加法的依赖链，可展开为向量指令
+            T s0 = 0, s1 = 0, s2 = 0, s3 = 0;
+            int p = 0;
+            for (; p + 4 <= k; p += 4) {
+                s0 += ai[p] * bj[p];
+                s1 += ai[p + 1] * bj[p + 1];
+                s2 += ai[p + 2] * bj[p + 2];
+                s3 += ai[p + 3] * bj[p + 3];
+            }
+            for (; p < k; ++p) s0 += ai[p] * bj[p];
+            matStoreDot(ci[j], alpha, T((s0 + s1) + (s2 + s3)), beta);
+        }
+    }
+}
+
+// ~A * B: A按k×m存放，A的第p行把B的第p行按比例累加到C的各行
+template <typename T>
+void matKernelTN(const T* A, int lda, const T* B, int ldb, T* C, int ldc, int m, int k, int n,
+                 T alpha = 1, T beta = 0) {
+    for (int i = 0; i < m; ++i) matScaleRow(C + (size_t)i * ldc, n, beta);
+    int p = 0;
+    // 同matKernel，一次并入4行，C每4项只扫描一遍
+    for (; p + 4 <= k; p += 4) {
+        const T* a0 = A + (size_t)p * lda;
+        const T* b0 = B + (size_t)p * ldb;
+        for (int i = 0; i < m; ++i) {
+            const T x0 = alpha * a0[i], x1 = alpha * a0[lda + i], x2 = alpha * a0[2 * (size_t)lda + i], x3 = alpha * a0[3 * (size_t)lda + i];
+            T* ci = C + (size_t)i * ldc;
+            for (int j = 0; j < n; ++j) ci[j] += x0 * b0[j] + x1 * b0[ldb + j] + x2 * b0[2 * (size_t)ldb + j] + x3 * b0[3 * (size_t)ldb + j];
+        }
+    }
+    for (; p < k; ++p) {
+        const T* ap = A + (size_t)p * lda;
+        const T* bp = B + (size_t)p * ldb;
+        for (int i = 0; i < m; ++i) {
+            const T a = alpha * ap[i];
+            T* ci = C + (size_t)i * ldc;
+            for (int j = 0; j < n; ++j) ci[j] += a * bp[j];
+        }
+    }
+}
+
+// ~A * ~B: A按k×m、B按n×k存放，C[i][j]为A第i列与B第j行的点积
+template <typename T>
+void matKernelTT(const T* A, int lda, const T* B, int ldb, T* C, int ldc, int m, int k, int n,
+                 T alpha = 1, T beta = 0) {
+    for (int i = 0; i < m; ++i) {
+        T* ci = C + (size_t)i * ldc;
+        for (int j = 0; j < n; ++j) {
+            const T* bj = B + (size_t)j * ldb;
+            T sum = 0;
+            for (int p = 0; p < k; ++p) sum += A[(size_t)p * lda + i] * bj[p];
+            matStoreDot(ci[j], alpha, sum, beta);
+        }
+    }
+}
+
+// Y(m×n) += alpha·X
+template <typename T>
+void matAxpyKernel(T alpha, const T* X, int ldx, T* Y, int ldy, int m, int n) {
+    for (int i = 0; i < m; ++i) {
+        const T* x = X + (size_t)i * ldx;
+        T* y = Y + (size_t)i * ldy;
+        for (int j = 0; j < n; ++j) y[j] += alpha * x[j];
+    }
+}
+
+// X(m×n) *= alpha
+template <typename T>
+void matScalKernel(T alpha, T* X, int ldx, int m, int n) {
+    for (int i = 0; i < m; ++i) {
+        T* x = X + (size_t)i * ldx;
+        for (int j = 0; j < n; ++j) x[j] *= alpha;
+    }
+}
+
+// 分块加减: Z(m×n) = X ± Y
+template <typename T>
+void matBlockAdd(const T* X, int ldx, const T* Y, int ldy, T* Z, int ldz, int m, int n, bool sub) {
+    for (int i = 0; i < m; ++i) {
+        const T* x = X + (size_t)i * ldx;
+        const T* y = Y + (size_t)i * ldy;
+        T* z = Z + (size_t)i * ldz;
+        if (sub) for (int j = 0; j < n; ++j) z[j] = x[j] - y[j];
+        else for (int j = 0; j < n; ++j) z[j] = x[j] + y[j];
+    }
+}
+
+// 单个元素格式化后的最大字符数(定点格式的double最长约317字符)
+const int MAT_ELEM_CHARS = 352;
+
+// 格式化一个元素到p，返回字符数；整数宽6、浮点定点6位小数宽8，与print一致
+template <typename T>
+int matFormatElem(char* p, const T& v) noexcept {
+    char tmp[MAT_ELEM_CHARS];
+    char* end = tmp;
+    int width = 0;
+    if constexpr (std::is_integral<T>::value) {
+        end = std::to_chars(tmp, tmp + sizeof(tmp), (long long)v).ptr;
+        width = 6;
+    }
+    else if constexpr (std::is_convertible<T, double>::value) { // 浮点及可转为浮点的存储类型(如bf16)
+        end = std::to_chars(tmp, tmp + sizeof(tmp), (double)v, std::chars_format::fixed, 6).ptr;
+        width = 8;
+    }
+    const int len = int(end - tmp), padn = std::max(0, width - len);
+    memset(p, ' ', padn);
+    memcpy(p + padn, tmp, len);
+    return padn + len;
+}
+
+// 把第[i0, i1)行格式化后分块交给sink(const char*, size_t)，整体只扫描一遍
+template <typename T, typename Sink>
+void matFormatRows(MatView<const T> a, int i0, int i1, Sink&& sink) {
+    char buf[8192];
+    size_t n = 0;
+    for (int i = i0; i < i1; ++i) {
+        const T* row = a[i];
+        for (int j = 0; j < a.cols(); ++j) {
+            if (n + MAT_ELEM_CHARS + 1 > sizeof(buf)) {
+                sink(buf, n);
+                n = 0;
+            }
+            n += matFormatElem(buf + n, row[j]);
+            buf[n++] = j != a.cols() - 1 ? ' ' : '\n';
+        }
+    }
+    if (n) sink(buf, n);
+}
+
+// 格式化为字符串；threads>1时各线程分段格式化若干行后按序拼接
+template <typename T>
+std::string matToString(MatView<const T> a, int threads = 1) {
+    threads = std::max(1, std::min(threads, a.rows()));
+    std::vector<std::string> parts(threads);
+    auto work = [&](int t) {
+        const int i0 = (int)((long long)a.rows() * t / threads), i1 = (int)((long long)a.rows() * (t + 1) / threads);
+        parts[t].reserve((size_t)(i1 - i0) * a.cols() * 9);
+        matFormatRows(a, i0, i1, [&](const char* p, size_t n) { parts[t].append(p, n); });
+    };
+    std::vector<std::thread> pool;
+    for (int t = 1; t < threads; ++t) pool.emplace_back(work, t);
+    work(0);
+    for (auto& th : pool) th.join();
+    size_t total = 0;
+    for (auto& s : parts) total += s.size();
+    std::string res;
+    res.reserve(total);
+    for (auto& s : parts) res += s;
+    return res;
+}
+
+// 格式化到大小为n的缓冲区，总以'\0'结尾，超出部分截断；返回完整输出所需的字符数(不含'\0')
+template <typename T>
+size_t matFormat(MatView<const T> a, char* s, size_t n) {
+    size_t total = 0;
+    matFormatRows(a, 0, a.rows(), [&](const char* p, size_t len) {
+        if (total + 1 < n) memcpy(s + total, p, std::min(len, n - 1 - total));
+        total += len;
+    });
+    if (n) s[std::min(total, n - 1)] = '\0';
+    return total;
+}
+
+// 带溢出检查的尺寸乘法: 元素个数、字节数均以size_t计，乘积超出size_t时抛length_error
+inline size_t matCheckedMul(size_t a, size_t b) {
+    if (a != 0 && b > SIZE_MAX / a) throw std::length_error("矩阵尺寸溢出");
+    return a * b;
+}
+
+// MAT元素存储的线程局部缓冲池: 释放的内存块按大小分桶保留，之后同桶的分配直接复用，
+// 省去malloc/free以及新分配大块内存的缺页；每线程保留的总字节数有上限，超出时直接归还系统
+class MatPool {
+public:
+    static constexpr size_t ALIGN = 64;
+    static constexpr size_t DEFAULT_LIMIT = (size_t)64 << 20;
+    static constexpr size_t MAX_POOLED = (size_t)1 << 40; // 更大的块不经过池，直接向系统分配
+
+    struct Stats {
+        unsigned long long hits = 0;     // 由池中取得
+        unsigned long long misses = 0;   // 向系统分配
+        unsigned long long returned = 0; // 释放时留在池中
+        unsigned long long dropped = 0;  // 释放时因超出上限归还系统
+        size_t retained = 0;             // 当前保留的字节数
+    };
+
+    // 本线程的池；线程退出、池已析构后返回nullptr
+    static MatPool* local() {
+        if (dead()) return nullptr;
+        thread_local MatPool p;
+        return &p;
+    }
+
+    // 分配至少bytes字节，按ALIGN对齐
+    static void* allocate(size_t bytes) {
+        MatPool* p = bytes <= MAX_POOLED ? local() : nullptr;
+        return p ? p->get(bytes) : ::operator new(bytes <= MAX_POOLED ? bucketSize(bytes) : bytes, std::align_val_t(ALIGN));
+    }
+    // 归还由allocate分配的bytes字节
+    static void deallocate(void* q, size_t bytes) noexcept {
+        MatPool* p = bytes <= MAX_POOLED ? local() : nullptr;
+        if (p) p->put(q, bytes);
+        else ::operator delete(q, std::align_val_t(ALIGN));
+    }
+
+    // 设置保留上限，0表示不保留(相当于不用池)；超出部分立即释放
+    void setLimit(size_t bytes) {
+        cap = bytes;
+        shrink();
+    }
+    size_t limit() const { return cap; }
+    // 释放所有保留的内存块
+    void trim() noexcept {
+        for (size_t b = 0; b < buckets.size(); ++b)
+            for (void* q : buckets[b]) ::operator delete(q, std::align_val_t(ALIGN));
+        buckets.clear();
+        st.retained = 0;
+    }
+    const Stats& stats() const { return st; }
+    void resetStats() {
+        const size_t kept = st.retained;
+        st = Stats();
+        st.retained = kept;
+    }
+
+    MatPool(const MatPool&) = delete;
+    MatPool& operator=(const MatPool&) = delete;
+
+private:
+    std::vector<std::vector<void*>> buckets;
+    size_t cap = DEFAULT_LIMIT;
+    Stats st;
+
+    MatPool() = default;
+    ~MatPool() noexcept {
+        trim();
+        dead() = true;
+    }
+    // 线程局部的析构标志: 平凡类型，池析构后仍可读取
+    static bool& dead() {
+        thread_local bool d = false;
+        return d;
+    }
+
+    // 桶编号: 每个2的幂区间再四等分，第b桶的块大小为(16 << b/4) * (4 + b%4)，即64、80、96、112、128、160……，浪费不超过25%
+    static size_t bucketBytes(size_t b) {
+        return ((size_t)16 << (b / 4)) * (4 + b % 4);
+    }
+    static size_t bucketOf(size_t bytes, size_t* size = nullptr) {
+        size_t b = 0;
+        while (bucketBytes(b) < bytes) ++b;
+        if (size) *size = bucketBytes(b);
+        return b;
+    }
+    static size_t bucketSize(size_t bytes) {
+        size_t size;
+        bucketOf(bytes, &size);
+        return size;
+    }
+
+    void* get(size_t bytes) {
+        size_t size;
+        const size_t b = bucketOf(bytes, &size);
+        if (b < buckets.size() && !buckets[b].empty()) {
+            void* q = buckets[b].back();
+            buckets[b].pop_back();
+            st.retained -= size;
+            ++st.hits;
+            return q;
+        }
+        ++st.misses;
+        return ::operator new(size, std::align_val_t(ALIGN));
+    }
+    void put(void* q, size_t bytes) noexcept {
+        size_t size;
+        const size_t b = bucketOf(bytes, &size);
+        if (st.retained + size > cap) {
+            ++st.dropped;
+            ::operator delete(q, std::align_val_t(ALIGN));
+            return;
+        }
+        try {
+            if (b >= buckets.size()) buckets.resize(b + 1);
+            buckets[b].push_back(q);
+        }
+        catch (...) {
+            ++st.dropped;
+            ::operator delete(q, std::align_val_t(ALIGN));
+            return;
+        }
+        st.retained += size;
+        ++st.returned;
+    }
+    // 从最大的桶开始释放，直到不超过上限
+    void shrink() noexcept {
+        for (size_t b = buckets.size(); b-- > 0 && st.retained > cap;)
+            while (!buckets[b].empty() && st.retained > cap) {
+                ::operator delete(buckets[b].back(), std::align_val_t(ALIGN));
+                buckets[b].pop_back();
+                st.retained -= bucketBytes(b);
+            }
+    }
+};
+
+template <typename T>
+class MAT<T, 0, 0> {
     T* const e;
     const int r, c;
+    const int ld; // 行跨度: 补齐到缓存行，使每行首地址按ALIGN字节对齐
+
+    // 行跨度: 元素大小整除ALIGN时把每行补齐到整缓存行
+    // 维度为负或补齐后超出int时抛异常
+    static int padStride(int c_) {
+        if (c_ < 0) throw std::invalid_argument("矩阵维度不能为负");
+        if (ALIGN % sizeof(T) != 0) return c_;
+        const long long per = (long long)(ALIGN / sizeof(T));
+        const long long ld_ = (c_ + per - 1) / per * per;
+        if (ld_ > INT_MAX) throw std::length_error("矩阵列数过大");
+        return (int)ld_;
+    }
+    // r_行、行跨度ld_的元素个数，行数为负或乘积溢出时抛异常
+    static size_t elems(int r_, int ld_) {
+        if (r_ < 0) throw std::invalid_argument("矩阵维度不能为负");
+        return matCheckedMul((size_t)r_, (size_t)ld_);
+    }
+    // 按ALIGN字节对齐分配n个值初始化的元素，内存取自本线程的缓冲池
+    static T* alloc(size_t n) {
+        T* p = static_cast<T*>(MatPool::allocate(matCheckedMul(n, sizeof(T))));
+        std::uninitialized_value_construct_n(p, n);
+        return p;
+    }
+    // 复制a的各行到本矩阵，维度已由调用者检查
+    void copyRows(MatView<const T> a) {
+        for (int i = 0; i < r; ++i)
+            std::copy_n(a[i], c, e + (size_t)i * ld);
+    }
 public:
+    static constexpr size_t ALIGN = MatPool::ALIGN;
+
     // 构造函数
-    MAT(int r_, int c_) : e(new T[r_ * c_]()), r(r_), c(c_) {}
+    MAT(int r_, int c_) : e(alloc(elems(r_, padStride(c_)))), r(r_), c(c_), ld(padStride(c_)) {}
 
     // 拷贝构造
-    MAT(const MAT& a) : e(new T[a.r * a.c]), r(a.r), c(a.c) {
-        for (int i = 0; i < r * c; ++i) e[i] = a.e[i];
+    MAT(const MAT& a) : e(alloc((size_t)a.r * a.ld)), r(a.r), c(a.c), ld(a.ld) {
+        std::copy_n(a.e, (size_t)r * ld, e);
+    }
+
+    // 由视图构造: 复制所视子块
+    explicit MAT(MatView<const T> a) : MAT(a.rows(), a.cols()) {
+        copyRows(a);
+    }
+
+    // 由转置视图构造: 此时才实际转置
+    MAT(TransView<T> a) : MAT(a.rows(), a.cols()) {
+        MAT_PROF_SCOPE("transpose", std::max(r, c));
+        MatView<const T> b = a.base();
+        for (int i = 0; i < b.rows(); ++i) {
+            const T* bi = b[i];
+            for (int j = 0; j < b.cols(); ++j) e[(size_t)j * ld + i] = bi[j];
+        }
     }
 
     // 移动构造
-    MAT(MAT&& a) noexcept : e(a.e), r(a.r), c(a.c) {
+    MAT(MAT&& a) noexcept : e(a.e), r(a.r), c(a.c), ld(a.ld) {
         *(T**)&a.e = nullptr; // hack: 允许指针为nullptr
         *(int*)&a.r = 0;
         *(int*)&a.c = 0;
+        *(int*)&a.ld = 0;
     }
 
     // 析构
     virtual ~MAT() noexcept {
-        delete[] e;
+        if (e == nullptr) return;
+        std::destroy_n(e, (size_t)r * ld);
+        MatPool::deallocate(e, (size_t)r * ld * sizeof(T));
     }
 
     // 下标运算符: 取r行首地址，越界抛异常
     virtual T* const operator[](int row) {
         if (row < 0 || row >= r)
             throw std::out_of_range("行下标越界");
-        return e + row * c;
+        return e + (size_t)row * ld;
+    }
+    virtual const T* operator[](int row) const {
+        if (row < 0 || row >= r)
+            throw std::out_of_range("行下标越界");
+        return e + (size_t)row * ld;
     }
 
+    // 视图
+    MatView<T> view() { return MatView<T>(e, r, c, ld); }
+    MatView<const T> view() const { return MatView<const T>(e, r, c, ld); }
+    operator MatView<T>() { return view(); }
+    operator MatView<const T>() const { return view(); }
+    // 子块: 自(i0, j0)起h行w列，不复制元素
+    MatView<T> block(int i0, int j0, int h, int w) { return view().block(i0, j0, h, w); }
+    MatView<const T> block(int i0, int j0, int h, int w) const { return view().block(i0, j0, h, w); }
+    // 自i0起n行
+    MatView<T> rowRange(int i0, int n) { return view().rowRange(i0, n); }
+    MatView<const T> rowRange(int i0, int n) const { return view().rowRange(i0, n); }
+    // 自j0起n列
+    MatView<T> colRange(int j0, int n) { return view().colRange(j0, n); }
+    MatView<const T> colRange(int j0, int n) const { return view().colRange(j0, n); }
+
     // 加法
     virtual MAT operator+(const MAT& a) const {
         if (r != a.r || c != a.c) throw std::invalid_argument("矩阵加法维度不符");
         MAT res(r, c);
-        for (int i = 0; i < r * c; ++i) res.e[i] = e[i] + a.e[i];
+        for (size_t i = 0; i < (size_t)r * ld; ++i) res.e[i] = e[i] + a.e[i];
         return res;
     }
+    virtual MAT operator+(MatView<const T> a) const {
+        return view() + a;
+    }
 
     // 减法
     virtual MAT operator-(const MAT& a) const {
         if (r != a.r || c != a.c) throw std::invalid_argument("矩阵减法维度不符");
         MAT res(r, c);
-        for (int i = 0; i < r * c; ++i) res.e[i] = e[i] - a.e[i];
+        for (size_t i = 0; i < (size_t)r * ld; ++i) res.e[i] = e[i] - a.e[i];
         return res;
     }
+    virtual MAT operator-(MatView<const T> a) const {
+        return view() - a;
+    }
 
     // 乘法
     virtual MAT operator*(const MAT& a) const {
-        if (c != a.r) throw std::invalid_argument("矩阵乘法维度不符");
-        MAT res(r, a.c);
-        for (int i = 0; i < r; ++i) {
-            for (int j = 0; j < a.c; ++j) {
-                T sum = 0;
-                for (int k = 0; k < c; ++k) {
-                    sum += (*this)[i][k] * a[k][j];
-                }
-                res[i][j] = sum;
-            }
-        }
+        return view() * a.view();
+    }
+    virtual MAT operator*(MatView<const T> a) const {
+        return view() * a;
+    }
+    virtual MAT operator*(TransView<T> a) const {
+        return view() * a;
+    }
+    // 数乘: 与scal共用同一核
+    virtual MAT operator*(T s) const {
+        MAT res(*this);
+        matScalKernel(s, res.e, res.ld, r, c);
         return res;
     }
 
-    // 转置
-    virtual MAT operator~() const {
-        MAT res(c, r);
-        for (int i = 0; i < r; ++i) for (int j = 0; j < c; ++j)
-            res[j][i] = (*this)[i][j];
-        return res;
+    // 转置: 返回转置视图，不复制元素；赋给MAT或参与乘法时才按需读取
+    virtual TransView<T> operator~() const {
+        return ~view();
     }
 
     // 赋值
     virtual MAT& operator=(const MAT& a) {
         if (this == &a) return *this;
         if (r != a.r || c != a.c) throw std::invalid_argument("赋值维度不符");
-        for (int i = 0; i < r * c; ++i) e[i] = a.e[i];
+        std::copy_n(a.e, (size_t)r * ld, e);
+        return *this;
+    }
+    // 由视图赋值: 复制所视子块
+    virtual MAT& operator=(MatView<const T> a) {
+        if (r != a.rows() || c != a.cols()) throw std::invalid_argument("赋值维度不符");
+        copyRows(a);
+        return *this;
+    }
+
+    // 由转置视图赋值
+    virtual MAT& operator=(TransView<T> a) {
+        if (r != a.rows() || c != a.cols()) throw std::invalid_argument("赋值维度不符");
+        MatView<const T> b = a.base();
+        // 源与本矩阵重叠(如m = ~m)时边读边写会覆盖未读元素，先转置到临时矩阵
+        if (b.data() < e + (size_t)r * ld && e < b.data() + (size_t)b.rows() * b.stride())
+            return *this = MAT(a);
+        MAT_PROF_SCOPE("transpose", std::max(r, c));
+        for (int i = 0; i < b.rows(); ++i) {
+            const T* bi = b[i];
+            for (int j = 0; j < b.cols(); ++j) e[(size_t)j * ld + i] = bi[j];
+        }
         return *this;
     }
 
@@ -90,20 +846,28 @@ public:
     virtual MAT& operator=(MAT&& a) noexcept {
         if (this == &a) return *this;
         if (r != a.r || c != a.c) throw std::invalid_argument("移动赋值维度不符");
-        for (int i = 0; i < r * c; ++i) e[i] = a.e[i];
+        std::copy_n(a.e, (size_t)r * ld, e);
         return *this;
     }
 
     // +=
     virtual MAT& operator+=(const MAT& a) {
         if (r != a.r || c != a.c) throw std::invalid_argument("+=维度不符");
-        for (int i = 0; i < r * c; ++i) e[i] += a.e[i];
+        for (size_t i = 0; i < (size_t)r * ld; ++i) e[i] += a.e[i];
+        return *this;
+    }
+    virtual MAT& operator+=(MatView<const T> a) {
+        view() += a;
         return *this;
     }
     // -=
     virtual MAT& operator-=(const MAT& a) {
         if (r != a.r || c != a.c) throw std::invalid_argument("-=维度不符");
-        for (int i = 0; i < r * c; ++i) e[i] -= a.e[i];
+        for (size_t i = 0; i < (size_t)r * ld; ++i) e[i] -= a.e[i];
+        return *this;
+    }
+    virtual MAT& operator-=(MatView<const T> a) {
+        view() -= a;
         return *this;
     }
     // *=
@@ -111,27 +875,40 @@ public:
         *this = *this * a;
         return *this;
     }
+    virtual MAT& operator*=(MatView<const T> a) {
+        *this = *this * a;
+        return *this;
+    }
+    virtual MAT& operator*=(T s) {
+        matScalKernel(s, e, ld, r, c);
+        return *this;
+    }
 
-    // 打印
+    // 打印: s须足够大；一遍写完，再回显到cout
     virtual char* print(char* s) const noexcept {
-        s[0] = 0; // 清空
-        char buf[128];
-        for (int i = 0; i < r; ++i) {
-            for (int j = 0; j < c; ++j) {
-                if constexpr (std::is_integral<T>::value) {
-                    sprintf(buf, "%6lld", (long long)(*this)[i][j]);
-                }
-                else if constexpr (std::is_floating_point<T>::value) {
-                    sprintf(buf, "%8lf", (double)(*this)[i][j]);
-                }
-                strcat(s, buf);
-                if (j != c - 1) strcat(s, " ");
-            }
-            strcat(s, "\n");
-        }
+        char* pos = s;
+        matFormatRows(view(), 0, r, [&](const char* p, size_t n) {
+            memcpy(pos, p, n);
+            pos += n;
+        });
+        *pos = 0;
         std::cout << s;
         return s;
     }
+    // 打印到大小为n的缓冲区，超出截断，不回显；返回完整输出所需的字符数
+    virtual size_t print(char* s, size_t n) const noexcept {
+        return matFormat(view(), s, n);
+    }
+    // 格式化为字符串，不回显；threads>1时按行并行格式化
+    std::string str(int threads = 1) const {
+        return matToString(view(), threads);
+    }
+
+    // 元素首地址: 每行首地址按ALIGN字节对齐，第i行始于data() + i * stride()
+    T* data() noexcept { return e; }
+    const T* data() const noexcept { return e; }
+    // 行跨度(元素个数)
+    int stride() const { return ld; }
 
     // 行数
     int rows() const { return r; }
@@ -139,9 +916,3340 @@ public:
     int cols() const { return c; }
 };
 
+// 视图运算: MAT的各算术运算最终都落到这里，操作数可以是任意子块
+template <typename T>
+MAT<typename MatView<T>::E> MatView<T>::operator+(MatView<const E> a) const {
+    if (r != a.rows() || c != a.cols()) throw std::invalid_argument("矩阵加法维度不符");
+    MAT<E> res(r, c);
+    matBlockAdd<E>(p, ld, a.data(), a.stride(), res.data(), res.stride(), r, c, false);
+    return res;
+}
+
+template <typename T>
+MAT<typename MatView<T>::E> MatView<T>::operator-(MatView<const E> a) const {
+    if (r != a.rows() || c != a.cols()) throw std::invalid_argument("矩阵减法维度不符");
+    MAT<E> res(r, c);
+    matBlockAdd<E>(p, ld, a.data(), a.stride(), res.data(), res.stride(), r, c, true);
+    return res;
+}
+
+template <typename T>
+MAT<typename MatView<T>::E> MatView<T>::operator*(MatView<const E> a) const {
+    if (c != a.rows()) throw std::invalid_argument("矩阵乘法维度不符");
+    MAT_PROF_SCOPE("mul", std::max({ r, c, a.cols() }));
+    MAT<E> res(r, a.cols());
+    matKernel<E>(p, ld, a.data(), a.stride(), res.data(), res.stride(), r, c, a.cols());
+    return res;
+}
+
+template <typename T>
+MAT<typename MatView<T>::E> MatView<T>::operator*(TransView<E> a) const {
+    MatView<const E> b = a.base();
+    if (c != b.cols()) throw std::invalid_argument("矩阵乘法维度不符");
+    MAT_PROF_SCOPE("mul_nt", std::max({ r, c, b.rows() }));
+    MAT<E> res(r, b.rows());
+    matKernelNT<E>(p, ld, b.data(), b.stride(), res.data(), res.stride(), r, c, b.rows());
+    return res;
+}
+
+template <typename T>
+TransView<typename MatView<T>::E> MatView<T>::operator~() const {
+    return TransView<E>(*this);
+}
+
+template <typename T>
+MAT<T> TransView<T>::operator*(MatView<const T> a) const {
+    if (v.rows() != a.rows()) throw std::invalid_argument("矩阵乘法维度不符");
+    MAT_PROF_SCOPE("mul_tn", std::max({ v.rows(), v.cols(), a.cols() }));
+    MAT<T> res(v.cols(), a.cols());
+    matKernelTN<T>(v.data(), v.stride(), a.data(), a.stride(), res.data(), res.stride(), v.cols(), v.rows(), a.cols());
+    return res;
+}
+
+template <typename T>
+MAT<T> TransView<T>::operator*(TransView a) const {
+    MatView<const T> b = a.base();
+    if (v.rows() != b.cols()) throw std::invalid_argument("矩阵乘法维度不符");
+    MAT_PROF_SCOPE("mul_tt", std::max({ v.rows(), v.cols(), b.rows() }));
+    MAT<T> res(v.cols(), b.rows());
+    matKernelTT<T>(v.data(), v.stride(), b.data(), b.stride(), res.data(), res.stride(), v.cols(), v.rows(), b.rows());
+    return res;
+}
+
+template <typename T>
+MAT<T> TransView<T>::operator+(MatView<const T> a) const {
+    return MAT<T>(*this) + a;
+}
+
+template <typename T>
+MAT<T> TransView<T>::operator-(MatView<const T> a) const {
+    return MAT<T>(*this) - a;
+}
+
+template <typename T>
+MAT<T> TransView<T>::operator*(T s) const {
+    return MAT<T>(*this) * s;
+}
+
+template <typename T>
+char* TransView<T>::print(char* s) const {
+    return MAT<T>(*this).print(s);
+}
+
+template <typename T>
+MatView<T>& MatView<T>::operator+=(MatView<const E> a) {
+    static_assert(!std::is_const<T>::value, "只读视图不能就地修改");
+    if (r != a.rows() || c != a.cols()) throw std::invalid_argument("+=维度不符");
+    matBlockAdd<E>(p, ld, a.data(), a.stride(), p, ld, r, c, false);
+    return *this;
+}
+
+template <typename T>
+MatView<T>& MatView<T>::operator-=(MatView<const E> a) {
+    static_assert(!std::is_const<T>::value, "只读视图不能就地修改");
+    if (r != a.rows() || c != a.cols()) throw std::invalid_argument("-=维度不符");
+    matBlockAdd<E>(p, ld, a.data(), a.stride(), p, ld, r, c, true);
+    return *this;
+}
+
+template <typename T>
+MatView<T>& MatView<T>::operator*=(MatView<const E> a) {
+    return assign(*this * a);
+}
+
+template <typename T>
+MatView<T>& MatView<T>::assign(MatView<const E> a) {
+    static_assert(!std::is_const<T>::value, "只读视图不能就地修改");
+    if (r != a.rows() || c != a.cols()) throw std::invalid_argument("赋值维度不符");
+    for (int i = 0; i < r; ++i)
+        std::copy_n(a[i], c, p + (size_t)i * ld);
+    return *this;
+}
+
+
+// 输出到流，一遍写完
+template <typename T>
+std::ostream& operator<<(std::ostream& os, MatView<T> a) {
+    matFormatRows(MatView<const T>(a), 0, a.rows(), [&](const char* p, size_t n) { os.write(p, (std::streamsize)n); });
+    return os;
+}
+template <typename T>
+std::ostream& operator<<(std::ostream& os, const MAT<T>& a) {
+    return os << a.view();
+}
+
+template <typename T>
+MAT<T> operator*(T s, const MAT<T>& a) {
+    return a * s;
+}
+
+// 仅由标量参数推导元素类型，矩阵参数可直接传MAT或视图
+template <typename T>
+struct NoDeduce { using type = T; };
+
+// 融合乘加(同BLAS gemm): C = alpha·op(A)·op(B) + beta·C，op为转置或不转置
+// 结果直接累加进C，不产生临时矩阵；beta为0时不读取C原值
+template <typename T>
+void gemm(T alpha, MatView<const typename NoDeduce<T>::type> A, bool transA,
+          MatView<const typename NoDeduce<T>::type> B, bool transB, T beta, MatView<typename NoDeduce<T>::type> C) {
+    const int m = transA ? A.cols() : A.rows(), k = transA ? A.rows() : A.cols();
+    const int kb = transB ? B.cols() : B.rows(), n = transB ? B.rows() : B.cols();
+    if (k != kb || C.rows() != m || C.cols() != n) throw std::invalid_argument("gemm维度不符");
+    const T* pa = A.data();
+    const T* pb = B.data();
+    const int lda = A.stride(), ldb = B.stride();
+    if (!transA && !transB) matKernel(pa, lda, pb, ldb, C.data(), C.stride(), m, k, n, alpha, beta);
+    else if (!transA) matKernelNT(pa, lda, pb, ldb, C.data(), C.stride(), m, k, n, alpha, beta);
+    else if (!transB) matKernelTN(pa, lda, pb, ldb, C.data(), C.stride(), m, k, n, alpha, beta);
+    else matKernelTT(pa, lda, pb, ldb, C.data(), C.stride(), m, k, n, alpha, beta);
+}
+template <typename T>
+void gemm(T alpha, MatView<const typename NoDeduce<T>::type> A, MatView<const typename NoDeduce<T>::type> B,
+          T beta, MatView<typename NoDeduce<T>::type> C) {
+    gemm(alpha, A, false, B, false, beta, C);
+}
+
+// Y += alpha·X
+template <typename T>
+void axpy(T alpha, MatView<const typename NoDeduce<T>::type> X, MatView<typename NoDeduce<T>::type> Y) {
+    if (X.rows() != Y.rows() || X.cols() != Y.cols()) throw std::invalid_argument("axpy维度不符");
+    matAxpyKernel(alpha, X.data(), X.stride(), Y.data(), Y.stride(), Y.rows(), Y.cols());
+}
+
+// X *= alpha
+template <typename T>
+void scal(T alpha, MatView<typename NoDeduce<T>::type> X) {
+    matScalKernel(alpha, X.data(), X.stride(), X.rows(), X.cols());
+}
+
+// 定长矩阵: 维度在编译期确定，元素内联存储，不分配堆内存
+// 运算通过折叠表达式完全展开，均可在常量表达式中求值；维度不符的运算无法通过编译
+template <typename T, int R, int C>
+class MAT {
+    static_assert(R > 0 && C > 0, "定长矩阵维度必须为正");
+    T e[R * C] = {};
+
+    template <typename, int, int> friend class MAT;
+
+    // 第i行与a的第j列的点积，k方向完全展开
+    template <int K, size_t... J>
+    constexpr T dot(int i, int j, const MAT<T, C, K>& a, std::index_sequence<J...>) const {
+        return ((e[i * C + J] * a.e[J * K + j]) + ...);
+    }
+    template <int K, size_t... I>
+    constexpr void mul(const MAT<T, C, K>& a, MAT<T, R, K>& res, std::index_sequence<I...>) const {
+        ((res.e[I] = dot(int(I) / K, int(I) % K, a, std::make_index_sequence<C>{})), ...);
+    }
+    template <size_t... I>
+    constexpr void add(const MAT& a, MAT& res, std::index_sequence<I...>) const {
+        ((res.e[I] = e[I] + a.e[I]), ...);
+    }
+    template <size_t... I>
+    constexpr void sub(const MAT& a, MAT& res, std::index_sequence<I...>) const {
+        ((res.e[I] = e[I] - a.e[I]), ...);
+    }
+    template <size_t... I>
+    constexpr void trans(MAT<T, C, R>& res, std::index_sequence<I...>) const {
+        ((res.e[(I % C) * R + I / C] = e[I]), ...);
+    }
+public:
+    // 构造函数: 全零
+    constexpr MAT() = default;
+
+    // 按行主序给出元素，不足部分补零
+    constexpr MAT(std::initializer_list<T> l) {
+        int i = 0;
+        for (auto it = l.begin(); it != l.end() && i < R * C; ++it) e[i++] = *it;
+    }
+
+    // 从动态矩阵构造，维度不符抛异常
+    explicit MAT(const MAT<T>& a) {
+        if (a.rows() != R || a.cols() != C) throw std::invalid_argument("定长矩阵维度不符");
+        for (int i = 0; i < R; ++i) for (int j = 0; j < C; ++j)
+            e[i * C + j] = a[i][j];
+    }
+
+    // 转为动态矩阵
+    explicit operator MAT<T>() const {
+        MAT<T> res(R, C);
+        for (int i = 0; i < R; ++i) for (int j = 0; j < C; ++j)
+            res[i][j] = e[i * C + j];
+        return res;
+    }
+
+    // 下标运算符: 取r行首地址，维度固定故不做越界检查
+    constexpr T* operator[](int row) { return e + row * C; }
+    constexpr const T* operator[](int row) const { return e + row * C; }
+
+    // 加法
+    constexpr MAT operator+(const MAT& a) const {
+        MAT res;
+        add(a, res, std::make_index_sequence<R * C>{});
+        return res;
+    }
+
+    // 减法
+    constexpr MAT operator-(const MAT& a) const {
+        MAT res;
+        sub(a, res, std::make_index_sequence<R * C>{});
+        return res;
+    }
+
+    // 乘法: 只接受C行的右操作数
+    template <int K>
+    constexpr MAT<T, R, K> operator*(const MAT<T, C, K>& a) const {
+        MAT<T, R, K> res;
+        mul(a, res, std::make_index_sequence<R * K>{});
+        return res;
+    }
+
+    // 转置
+    constexpr MAT<T, C, R> operator~() const {
+        MAT<T, C, R> res;
+        trans(res, std::make_index_sequence<R * C>{});
+        return res;
+    }
+
+    // +=
+    constexpr MAT& operator+=(const MAT& a) {
+        return *this = *this + a;
+    }
+    // -=
+    constexpr MAT& operator-=(const MAT& a) {
+        return *this = *this - a;
+    }
+    // *=: 只有方阵才能保持维度
+    constexpr MAT& operator*=(const MAT<T, C, C>& a) {
+        return *this = *this * a;
+    }
+
+    constexpr bool operator==(const MAT& a) const {
+        for (int i = 0; i < R * C; ++i) if (!(e[i] == a.e[i])) return false;
+        return true;
+    }
+    constexpr bool operator!=(const MAT& a) const { return !(*this == a); }
+
+    // 打印
+    char* print(char* s) const noexcept {
+        char* pos = s;
+        matFormatRows(MatView<const T>(e, R, C, C), 0, R, [&](const char* p, size_t n) {
+            memcpy(pos, p, n);
+            pos += n;
+        });
+        *pos = 0;
+        std::cout << s;
+        return s;
+    }
+
+    // 行数
+    static constexpr int rows() { return R; }
+    // 列数
+    static constexpr int cols() { return C; }
+};
+
+// 视图测试: 对齐、行跨度及子块直接参与运算
+void testMatView() {
+    char t[2048];
+    MAT<double> a(4, 5), b(5, 3), c(4, 3);
+    for (int i = 0; i < 4; ++i) for (int j = 0; j < 5; ++j) a[i][j] = i + j;
+    for (int i = 0; i < 5; ++i) for (int j = 0; j < 3; ++j) b[i][j] = i == j;
+    cout << "行跨度: " << a.stride() << " 首地址对齐: "
+         << ((uintptr_t)a.data() % MAT<double>::ALIGN == 0 && (uintptr_t)a[1] % MAT<double>::ALIGN == 0) << endl;
+
+    // 分块乘法: 左右两半分别相乘再累加到同一块结果上
+    c.block(0, 0, 4, 3) += a.colRange(0, 2) * b.rowRange(0, 2);
+    c.block(0, 0, 4, 3) += a.colRange(2, 3) * b.rowRange(2, 3);
+    c.print(t);
+    (a * b).print(t);
+
+    MAT<double> tile(a.block(1, 1, 2, 2));
+    tile.print(t);
+    (tile + a.block(2, 3, 2, 2)).print(t);
+    a.block(0, 0, 2, 2).assign(tile);
+    MAT<double>(~a.rowRange(0, 2)).print(t);
+}
+
+// 转置视图测试: 各种转置组合的乘法与先实际转置再相乘的结果对比
+void testTransView() {
+    MAT<int> a(3, 4), b(5, 4), g(3, 3);
+    for (int i = 0; i < 3; ++i) for (int j = 0; j < 4; ++j) a[i][j] = i * 4 + j - 5;
+    for (int i = 0; i < 5; ++i) for (int j = 0; j < 4; ++j) b[i][j] = (i + 2) * (j - 1);
+    MAT<int> at = ~a, bt = ~b;
+    auto same = [](const MAT<int>& x, const MAT<int>& y) {
+        if (x.rows() != y.rows() || x.cols() != y.cols()) return false;
+        for (int i = 0; i < x.rows(); ++i) for (int j = 0; j < x.cols(); ++j)
+            if (x[i][j] != y[i][j]) return false;
+        return true;
+    };
+    bool ok = same(a * ~b, a * bt) && same(~a * a, at * a) && same(~at * ~b, a * bt)
+        && same(~~a * bt, a * bt) && same(MAT<int>(~at), a);
+    g = a * ~a; // Gram矩阵，不生成转置副本
+    ok = ok && same(g, a * at);
+
+    // 自身转置赋值: 源与目标重叠
+    MAT<int> m(3, 3), mt(3, 3);
+    for (int i = 0; i < 3; ++i) for (int j = 0; j < 3; ++j) m[i][j] = i * 3 + j, mt[j][i] = i * 3 + j;
+    m = ~m;
+    ok = ok && same(m, mt);
+    m = ~m.block(0, 0, 3, 3);
+    ok = ok && same(m, ~mt);
+
+    // 乘法以外的运算先实际转置
+    ok = ok && same(~a + at, at * 2) && same(~a - at, at * 0) && same(~a * 3, at * 3) && same(at + ~a, at * 2);
+    char t[256], u[256];
+    (~a).print(t);
+    at.print(u);
+    ok = ok && strcmp(t, u) == 0;
+    cout << (ok ? "转置视图乘法正确" : "转置视图乘法错误") << endl;
+}
+
+// 定长矩阵测试: 编译期求值及与动态矩阵的互转
+void testFixedMAT() {
+    char t[2048];
+    constexpr MAT<int, 2, 3> a = { 1, 2, 3, 4, 5, 6 };
+    constexpr MAT<int, 3, 2> b = { 7, 8, 9, 10, 11, 12 };
+    constexpr MAT<int, 2, 2> p = a * b;
+    static_assert(p[0][0] == 58 && p[0][1] == 64 && p[1][0] == 139 && p[1][1] == 154, "定长矩阵乘法错误");
+    static_assert((~a)[2][1] == 6 && (a + a)[1][2] == 12 && (a - a)[0][0] == 0, "定长矩阵运算错误");
+    static_assert(~~a == a, "定长矩阵转置错误");
+    // a * a; // 维度不符，无法通过编译
+    p.print(t);
+
+    MAT<float, 4, 4> m = { 1, 0, 0, 2, 0, 1, 0, 3, 0, 0, 1, 4, 0, 0, 0, 1 };
+    MAT<float, 4, 1> v = { 1, 1, 1, 1 };
+    (m * v).print(t);
+    m *= m;
+    m.print(t);
+
+    MAT<int> d = MAT<int>(a * b);
+    MAT<int, 2, 2> f(d);
+    cout << (f == p ? "定长矩阵互转正确" : "定长矩阵互转错误") << endl;
+}
+
+
+// Strassen-Winograd工作区: 一次分配，多次乘法间复用，递归各层按栈式从中切分
+template <typename T>
+class StrassenWorkspace {
+    T* buf = nullptr;
+    size_t cap = 0;
+public:
+    StrassenWorkspace() = default;
+    StrassenWorkspace(const StrassenWorkspace&) = delete;
+    StrassenWorkspace& operator=(const StrassenWorkspace&) = delete;
+    ~StrassenWorkspace() noexcept { delete[] buf; }
+
+    // 保证至少有n个元素，不足时才重新分配
+    T* reserve(size_t n) {
+        if (n > cap) {
+            delete[] buf;
+            buf = new T[n];
+            cap = n;
+        }
+        return buf;
+    }
+    size_t capacity() const { return cap; }
+};
+
+// n阶递归一层所需的临时空间: S1~S4, T1~T4, P1~P7 共15块h×h
+inline size_t strassenLevelSize(int n) {
+    size_t h = n / 2;
+    return 15 * h * h;
+}
+
+// Winograd变体: 7次乘法、15次加减；n不超过cutoff或为奇数时转普通乘法核
+template <typename T>
+void strassenRec(const T* A, int lda, const T* B, int ldb, T* C, int ldc, int n, int cutoff, T* ws) {
+    if (n <= cutoff || n % 2 != 0) {
+        matKernel(A, lda, B, ldb, C, ldc, n, n, n);
+        return;
+    }
+    const int h = n / 2;
+    const size_t hh = (size_t)h * h;
+    const T *A11 = A, *A12 = A + h, *A21 = A + (size_t)h * lda, *A22 = A21 + h;
+    const T *B11 = B, *B12 = B + h, *B21 = B + (size_t)h * ldb, *B22 = B21 + h;
+    T *C11 = C, *C12 = C + h, *C21 = C + (size_t)h * ldc, *C22 = C21 + h;
+    T *S1 = ws, *S2 = S1 + hh, *S3 = S2 + hh, *S4 = S3 + hh;
+    T *T1 = S4 + hh, *T2 = T1 + hh, *T3 = T2 + hh, *T4 = T3 + hh;
+    T *P1 = T4 + hh, *P2 = P1 + hh, *P3 = P2 + hh, *P4 = P3 + hh;
+    T *P5 = P4 + hh, *P6 = P5 + hh, *P7 = P6 + hh;
+    T* next = P7 + hh;
+
+    matBlockAdd(A21, lda, A22, lda, S1, h, h, h, false);     // S1 = A21 + A22
+    matBlockAdd(S1, h, A11, lda, S2, h, h, h, true);         // S2 = S1 - A11
+    matBlockAdd(A11, lda, A21, lda, S3, h, h, h, true);      // S3 = A11 - A21
+    matBlockAdd(A12, lda, S2, h, S4, h, h, h, true);         // S4 = A12 - S2
+    matBlockAdd(B12, ldb, B11, ldb, T1, h, h, h, true);      // T1 = B12 - B11
+    matBlockAdd(B22, ldb, T1, h, T2, h, h, h, true);         // T2 = B22 - T1
+    matBlockAdd(B22, ldb, B12, ldb, T3, h, h, h, true);      // T3 = B22 - B12
+    matBlockAdd(T2, h, B21, ldb, T4, h, h, h, true);         // T4 = T2 - B21
+
+    strassenRec(A11, lda, B11, ldb, P1, h, h, cutoff, next);
+    strassenRec(A12, lda, B21, ldb, P2, h, h, cutoff, next);
+    strassenRec(S4, h, B22, ldb, P3, h, h, cutoff, next);
+    strassenRec(A22, lda, T4, h, P4, h, h, cutoff, next);
+    strassenRec(S1, h, T1, h, P5, h, h, cutoff, next);
+    strassenRec(S2, h, T2, h, P6, h, h, cutoff, next);
+    strassenRec(S3, h, T3, h, P7, h, h, cutoff, next);
+
+    matBlockAdd(P1, h, P2, h, C11, ldc, h, h, false);        // C11 = P1 + P2
+    matBlockAdd(P1, h, P6, h, P6, h, h, h, false);           // U2 = P1 + P6
+    matBlockAdd(P6, h, P7, h, P7, h, h, h, false);           // U3 = U2 + P7
+    matBlockAdd(P6, h, P5, h, P6, h, h, h, false);           // U4 = U2 + P5
+    matBlockAdd(P6, h, P3, h, C12, ldc, h, h, false);        // C12 = U4 + P3
+    matBlockAdd(P7, h, P4, h, C21, ldc, h, h, true);         // C21 = U3 - P4
+    matBlockAdd(P7, h, P5, h, C22, ldc, h, h, false);        // C22 = U3 + P5
+}
+
+// Strassen-Winograd方阵乘法，只用于浮点矩阵
+// 阶数补零到 m·2^L (m不超过cutoff)，递归L层后转普通乘法核；临时空间全部取自ws
+template <typename T>
+MAT<T> strassen(const MAT<T>& a, const MAT<T>& b, int cutoff = 64, StrassenWorkspace<T>* ws = nullptr) {
+    static_assert(std::is_floating_point<T>::value, "Strassen乘法只用于浮点矩阵");
+    const int n = a.rows();
+    if (n != a.cols() || n != b.rows() || n != b.cols())
+        throw std::invalid_argument("Strassen乘法要求同阶方阵");
+    if (cutoff < 1) throw std::invalid_argument("Strassen截断阶数必须为正");
+    thread_local StrassenWorkspace<T> local;
+    if (ws == nullptr) ws = &local;
+
+    MAT<T> res(n, n);
+    int m = n, levels = 0;
+    while (m > cutoff) {
+        m = (m + 1) / 2;
+        ++levels;
+    }
+    const int N = m << levels;
+    size_t need = 0;
+    for (int s = N; s > m; s /= 2) need += strassenLevelSize(s);
+    const bool pad = N != n;
+    if (pad) need += 3 * (size_t)N * N;
+    T* w = ws->reserve(need);
+
+    if (!pad) {
+        strassenRec(a.data(), a.stride(), b.data(), b.stride(), res.data(), res.stride(), n, cutoff, w);
+        return res;
+    }
+    T *pa = w, *pb = pa + (size_t)N * N, *pc = pb + (size_t)N * N;
+    for (size_t i = 0; i < 2 * (size_t)N * N; ++i) pa[i] = 0;
+    for (int i = 0; i < n; ++i) for (int j = 0; j < n; ++j) {
+        pa[(size_t)i * N + j] = a[i][j];
+        pb[(size_t)i * N + j] = b[i][j];
+    }
+    strassenRec(pa, N, pb, N, pc, N, N, cutoff, pc + (size_t)N * N);
+    for (int i = 0; i < n; ++i) for (int j = 0; j < n; ++j)
+        res[i][j] = pc[(size_t)i * N + j];
+    return res;
+}
+
+// Strassen测试: 与普通乘法对比，含需补零的奇数阶
+void testStrassen() {
+    for (int n : { 8, 37, 100 }) {
+        MAT<double> a(n, n), b(n, n);
+        for (int i = 0; i < n; ++i) for (int j = 0; j < n; ++j) {
+            a[i][j] = (i * 7 + j * 3) % 11 - 5;
+            b[i][j] = (i * 5 + j * 2) % 13 - 6;
+        }
+        MAT<double> c1 = a * b, c2 = strassen(a, b, 4);
+        double err = 0;
+        for (int i = 0; i < n; ++i) for (int j = 0; j < n; ++j)
+            err = std::max(err, std::fabs(c1[i][j] - c2[i][j]));
+        cout << "Strassen n=" << n << " 最大误差: " << err << endl;
+    }
+}
+
+// Strassen基准: 最大相对误差及与普通乘法核的耗时，找出交叉点
+template <typename T>
+void benchStrassen(const char* name, int cutoff) {
+    StrassenWorkspace<T> ws;
+    int crossover = 0;
+    cout << "Strassen<" << name << "> cutoff=" << cutoff << endl;
+    for (int n = 64; n <= 1024; n *= 2) {
+        MAT<T> a(n, n), b(n, n), ref(n, n);
+        unsigned seed = 12345;
+        for (int i = 0; i < n; ++i) for (int j = 0; j < n; ++j) {
+            seed = seed * 1103515245u + 12345u;
+            a[i][j] = T((seed >> 8) % 2001) / 1000 - 1;
+            seed = seed * 1103515245u + 12345u;
+            b[i][j] = T((seed >> 8) % 2001) / 1000 - 1;
+        }
+        auto t0 = std::chrono::steady_clock::now();
+        matKernel(a.data(), a.stride(), b.data(), b.stride(), ref.data(), ref.stride(), n, n, n);
+        auto t1 = std::chrono::steady_clock::now();
+        MAT<T> s = strassen(a, b, cutoff, &ws);
+        auto t2 = std::chrono::steady_clock::now();
+        // 相对误差以 |A|·|B| 为尺度，避免抵消后接近0的元素放大误差
+        double err = 0;
+        for (int i = 0; i < n; ++i) for (int j = 0; j < n; ++j) {
+            double scale = 0;
+            for (int k = 0; k < n; ++k) scale += std::fabs((double)a[i][k] * b[k][j]);
+            err = std::max(err, std::fabs((double)s[i][j] - ref[i][j]) / scale);
+        }
+        double tc = std::chrono::duration<double, std::milli>(t1 - t0).count();
+        double ts = std::chrono::duration<double, std::milli>(t2 - t1).count();
+        // 交叉点: 此后各阶Strassen均更快的最小阶数
+        if (n > cutoff) crossover = ts < tc ? (crossover ? crossover : n) : 0;
+        cout << setw(6) << n << "  普通 " << setw(10) << tc << " ms  Strassen " << setw(10) << ts
+             << " ms  最大相对误差 " << err << endl;
+    }
+    if (crossover) cout << "交叉点: n=" << crossover << endl;
+    else cout << "测试范围内Strassen未胜出" << endl;
+}
+
+// 三元组: 稀疏矩阵的一个非零元
+template <typename T>
+struct Triplet {
+    int row, col;
+    T val;
+};
+
+// 压缩稀疏行(CSR)矩阵；其转置即原矩阵的压缩稀疏列(CSC)表示
+// 存储与运算量只与非零元个数成正比，与维度无关
+template <typename T>
+class SPMAT {
+    int r, c;
+    std::vector<int> rowPtr; // 第i行非零元位于[rowPtr[i], rowPtr[i+1])
+    std::vector<int> colIdx;
+    std::vector<T> vals;
+
+    static int checkDim(int n) {
+        if (n < 0) throw std::invalid_argument("稀疏矩阵维度非法");
+        return n;
+    }
+    SPMAT(int r_, int c_, size_t nnz) : r(checkDim(r_)), c(checkDim(c_)), rowPtr((size_t)r + 1, 0) {
+        colIdx.reserve(nnz);
+        vals.reserve(nnz);
+    }
+public:
+    // 由稠密矩阵构造，跳过零元
+    explicit SPMAT(const MAT<T>& a) : SPMAT(a.rows(), a.cols(), 0) {
+        for (int i = 0; i < r; ++i) {
+            const T* row = a[i];
+            for (int j = 0; j < c; ++j) {
+                if (row[j] != T(0)) {
+                    colIdx.push_back(j);
+                    vals.push_back(row[j]);
+                }
+            }
+            rowPtr[i + 1] = (int)vals.size();
+        }
+    }
+
+    // 由三元组构造，顺序任意，重复位置累加
+    SPMAT(int r_, int c_, std::vector<Triplet<T>> t) : SPMAT(r_, c_, t.size()) {
+        for (const auto& x : t)
+            if (x.row < 0 || x.row >= r || x.col < 0 || x.col >= c)
+                throw std::out_of_range("三元组下标越界");
+        std::sort(t.begin(), t.end(), [](const Triplet<T>& x, const Triplet<T>& y) {
+            return x.row != y.row ? x.row < y.row : x.col < y.col;
+        });
+        for (size_t k = 0; k < t.size(); ++k) {
+            if (k > 0 && t[k].row == t[k - 1].row && t[k].col == t[k - 1].col)
+                vals.back() += t[k].val;
+            else {
+                colIdx.push_back(t[k].col);
+                vals.push_back(t[k].val);
+                ++rowPtr[t[k].row + 1];
+            }
+        }
+        for (int i = 0; i < r; ++i) rowPtr[i + 1] += rowPtr[i];
+    }
+
+    // 转为稠密矩阵
+    MAT<T> dense() const {
+        MAT<T> res(r, c);
+        for (int i = 0; i < r; ++i)
+            for (int k = rowPtr[i]; k < rowPtr[i + 1]; ++k)
+                res[i][colIdx[k]] = vals[k];
+        return res;
+    }
+
+    // 稀疏矩阵乘向量: y = A x，x长c、y长r
+    void spmv(const T* x, T* y) const {
+        for (int i = 0; i < r; ++i) {
+            T sum = 0;
+            for (int k = rowPtr[i]; k < rowPtr[i + 1]; ++k) sum += vals[k] * x[colIdx[k]];
+            y[i] = sum;
+        }
+    }
+
+    // 稀疏乘稠密，结果为稠密矩阵；每个非零元贡献B的一整行
+    MAT<T> operator*(MatView<const T> b) const {
+        if (c != b.rows()) throw std::invalid_argument("稀疏矩阵乘法维度不符");
+        const int n = b.cols();
+        MAT<T> res(r, n);
+        for (int i = 0; i < r; ++i) {
+            T* ci = res[i];
+            for (int k = rowPtr[i]; k < rowPtr[i + 1]; ++k) {
+                const T v = vals[k];
+                const T* bk = b[colIdx[k]];
+                for (int j = 0; j < n; ++j) ci[j] += v * bk[j];
+            }
+        }
+        return res;
+    }
+
+    // 稀疏加法: 逐行归并，结果仍为稀疏矩阵
+    SPMAT operator+(const SPMAT& a) const {
+        if (r != a.r || c != a.c) throw std::invalid_argument("稀疏矩阵加法维度不符");
+        SPMAT res(r, c, vals.size() + a.vals.size());
+        for (int i = 0; i < r; ++i) {
+            int p = rowPtr[i], q = a.rowPtr[i];
+            const int pe = rowPtr[i + 1], qe = a.rowPtr[i + 1];
+            while (p < pe || q < qe) {
+                int j;
+                T v;
+                if (q == qe || (p < pe && colIdx[p] < a.colIdx[q])) {
+                    j = colIdx[p];
+                    v = vals[p++];
+                }
+                else if (p == pe || a.colIdx[q] < colIdx[p]) {
+                    j = a.colIdx[q];
+                    v = a.vals[q++];
+                }
+                else {
+                    j = colIdx[p];
+                    v = vals[p++] + a.vals[q++];
+                }
+                if (v != T(0)) {
+                    res.colIdx.push_back(j);
+                    res.vals.push_back(v);
+                }
+            }
+            res.rowPtr[i + 1] = (int)res.vals.size();
+        }
+        return res;
+    }
+
+    // 转置: 计数排序，O(nnz + r + c)；结果的CSR即原矩阵的CSC
+    SPMAT operator~() const {
+        SPMAT res(c, r, vals.size());
+        res.colIdx.resize(vals.size());
+        res.vals.resize(vals.size());
+        for (int k = 0; k < (int)colIdx.size(); ++k) ++res.rowPtr[colIdx[k] + 1];
+        for (int j = 0; j < c; ++j) res.rowPtr[j + 1] += res.rowPtr[j];
+        std::vector<int> next(res.rowPtr.begin(), res.rowPtr.end() - 1);
+        for (int i = 0; i < r; ++i)
+            for (int k = rowPtr[i]; k < rowPtr[i + 1]; ++k) {
+                int dst = next[colIdx[k]]++;
+                res.colIdx[dst] = i;
+                res.vals[dst] = vals[k];
+            }
+        return res;
+    }
+
+    // 非零元个数
+    int nnz() const { return (int)vals.size(); }
+    // 占用字节数
+    size_t bytes() const {
+        return rowPtr.size() * sizeof(int) + colIdx.size() * sizeof(int) + vals.size() * sizeof(T);
+    }
+    // 行数
+    int rows() const { return r; }
+    // 列数
+    int cols() const { return c; }
+};
+
+// 稀疏矩阵测试: 与稠密运算结果对比
+void testSparse() {
+    char t[2048];
+    MAT<int> a(3, 4), b(4, 2);
+    a[0][1] = 2; a[1][0] = 1; a[1][3] = 5; a[2][2] = -3;
+    for (int i = 0; i < 4; ++i) { b[i][0] = i + 1; b[i][1] = 10 * (i + 1); }
+    SPMAT<int> sa(a);
+    cout << "稀疏矩阵 nnz=" << sa.nnz() << endl;
+    (sa * b).print(t);
+    (a * b).print(t);
+
+    SPMAT<int> sb(3, 4, { { 2, 2, 3 }, { 0, 0, 7 }, { 0, 0, 1 } });
+    (sa + sb).dense().print(t);
+    (~sa).dense().print(t);
+
+    int x[4] = { 1, 1, 1, 1 }, y[3];
+    sa.spmv(x, y);
+    cout << "SpMV: " << y[0] << " " << y[1] << " " << y[2] << endl;
+
+    try { SPMAT<int> bad(-2, 3, std::vector<Triplet<int>>()); }
+    catch (const std::invalid_argument& e) { cout << "异常: " << e.what() << endl; }
+}
+
+// 64位文件定位: Windows上long只有32位，fseek越不过2GB
+inline int matFileSeek(FILE* fp, uint64_t off, int whence = SEEK_SET) {
+#ifdef _WIN32
+    return _fseeki64(fp, (long long)off, whence);
+#else
+    return fseeko(fp, (off_t)off, whence);
+#endif
+}
+
+// 二进制矩阵文件: 64字节文件头 + 按行跨度存放的元素
+// 元素区起始于64字节边界，行跨度沿用MAT的补齐跨度，映射后每行首地址仍按缓存行对齐
+struct MatFileHeader {
+    char magic[4];     // "MATB"
+    uint32_t endian;   // 按写入方字节序存放的0x01020304，读取方据此判断是否需要翻转
+    uint16_t version;  // 格式版本，当前为1
+    char kind;         // 元素类别: 'i'有符号整数，'u'无符号整数，'f'浮点
+    uint8_t elemSize;  // 元素字节数
+    uint32_t reserved;
+    uint64_t rows, cols;
+    uint64_t stride;   // 行跨度(元素个数)
+    uint64_t offset;   // 元素区相对文件头的字节偏移
+    char pad[16];
+};
+static_assert(sizeof(MatFileHeader) == 64, "矩阵文件头应为64字节");
+
+const uint32_t MAT_FILE_ENDIAN = 0x01020304;
+
+template <typename T>
+constexpr char matFileKind() {
+    static_assert(std::is_arithmetic<T>::value, "矩阵文件只支持算术类型");
+    return std::is_floating_point<T>::value ? 'f' : std::is_signed<T>::value ? 'i' : 'u';
+}
+
+// 逐字节翻转一个标量
+template <typename U>
+U byteSwap(U v) {
+    unsigned char* b = reinterpret_cast<unsigned char*>(&v);
+    std::reverse(b, b + sizeof(U));
+    return v;
+}
+
+// 读取并检查文件头，返回是否与本机字节序相反
+template <typename T>
+bool matFileCheckHeader(MatFileHeader& h) {
+    if (memcmp(h.magic, "MATB", 4) != 0) throw std::runtime_error("不是矩阵文件");
+    bool swapped = h.endian != MAT_FILE_ENDIAN;
+    if (swapped) {
+        if (byteSwap(h.endian) != MAT_FILE_ENDIAN) throw std::runtime_error("矩阵文件字节序标记损坏");
+        h.version = byteSwap(h.version);
+        h.rows = byteSwap(h.rows);
+        h.cols = byteSwap(h.cols);
+        h.stride = byteSwap(h.stride);
+        h.offset = byteSwap(h.offset);
+    }
+    if (h.version != 1) throw std::runtime_error("矩阵文件版本不支持");
+    if (h.kind != matFileKind<T>() || h.elemSize != sizeof(T))
+        throw std::runtime_error("矩阵文件元素类型不符");
+    if (h.rows > INT_MAX || h.cols > INT_MAX || h.stride > INT_MAX || h.stride < h.cols || h.offset < sizeof(MatFileHeader))
+        throw std::runtime_error("矩阵文件头损坏");
+    return swapped;
+}
+
+// 保存为二进制矩阵文件，失败抛异常
+template <typename T>
+void matSave(MatView<T> a, const char* path) {
+    using E = typename std::remove_const<T>::type;
+    MatFileHeader h = {};
+    memcpy(h.magic, "MATB", 4);
+    h.endian = MAT_FILE_ENDIAN;
+    h.version = 1;
+    h.kind = matFileKind<E>();
+    h.elemSize = sizeof(E);
+    h.rows = a.rows();
+    h.cols = a.cols();
+    h.stride = a.stride();
+    h.offset = sizeof(MatFileHeader);
+    FILE* f = fopen(path, "wb");
+    if (f == nullptr) throw std::runtime_error("无法创建矩阵文件");
+    bool ok = fwrite(&h, sizeof(h), 1, f) == 1;
+    // 跨度与行宽相同时整块写出，否则逐行写出并补零
+    if (a.stride() == a.cols() || a.rows() == 0)
+        ok = ok && fwrite(a.data(), sizeof(E), (size_t)a.rows() * a.cols(), f) == (size_t)a.rows() * a.cols();
+    else {
+        std::vector<E> zeros(a.stride() - a.cols());
+        for (int i = 0; i < a.rows() && ok; ++i) {
+            ok = fwrite(a[i], sizeof(E), a.cols(), f) == (size_t)a.cols();
+            if (!zeros.empty()) ok = ok && fwrite(zeros.data(), sizeof(E), zeros.size(), f) == zeros.size();
+        }
+    }
+    if (fclose(f) != 0 || !ok) throw std::runtime_error("写入矩阵文件失败");
+}
+template <typename T>
+void matSave(const MAT<T>& a, const char* path) {
+    matSave(a.view(), path);
+}
+
+// 从二进制矩阵文件读入，字节序不同时自动翻转
+template <typename T>
+MAT<T> matLoad(const char* path) {
+    FILE* f = fopen(path, "rb");
+    if (f == nullptr) throw std::runtime_error("无法打开矩阵文件");
+    MatFileHeader h;
+    try {
+        if (fread(&h, sizeof(h), 1, f) != 1) throw std::runtime_error("矩阵文件头不完整");
+        bool swapped = matFileCheckHeader<T>(h);
+        MAT<T> res((int)h.rows, (int)h.cols);
+        bool ok = matFileSeek(f, h.offset) == 0;
+        // 文件跨度与内存跨度一致时整块读入
+        if ((uint64_t)res.stride() == h.stride)
+            ok = ok && fread(res.data(), sizeof(T), (size_t)h.rows * h.stride, f) == (size_t)h.rows * h.stride;
+        else {
+            for (int i = 0; i < res.rows() && ok; ++i) {
+                ok = fread(res[i], sizeof(T), (size_t)h.cols, f) == (size_t)h.cols;
+                ok = ok && matFileSeek(f, (h.stride - h.cols) * sizeof(T), SEEK_CUR) == 0;
+            }
+        }
+        if (!ok) throw std::runtime_error("矩阵文件数据不完整");
+        if (swapped) {
+            for (int i = 0; i < res.rows(); ++i) {
+                T* row = res[i];
+                for (int j = 0; j < res.cols(); ++j) row[j] = byteSwap(row[j]);
+            }
+        }
+        fclose(f);
+        return res;
+    }
+    catch (...) {
+        fclose(f);
+        throw;
+    }
+}
+
+// 只读内存映射的矩阵文件: 不复制元素，直接以视图形式参与运算
+// 要求文件与本机字节序相同
+template <typename T>
+class MappedMAT {
+    void* base = nullptr;
+    size_t len = 0;
+#ifdef _WIN32
+    HANDLE file = INVALID_HANDLE_VALUE, mapping = nullptr;
+#endif
+    MatView<const T> v;
+
+    void unmap() noexcept {
+#ifdef _WIN32
+        if (base) UnmapViewOfFile(base);
+        if (mapping) CloseHandle(mapping);
+        if (file != INVALID_HANDLE_VALUE) CloseHandle(file);
+#else
+        if (base) munmap(base, len);
+#endif
+    }
+public:
+    explicit MappedMAT(const char* path) : v(nullptr, 0, 0, 0) {
+#ifdef _WIN32
+        file = CreateFileA(path, GENERIC_READ, FILE_SHARE_READ, nullptr, OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, nullptr);
+        if (file == INVALID_HANDLE_VALUE) throw std::runtime_error("无法打开矩阵文件");
+        LARGE_INTEGER size;
+        GetFileSizeEx(file, &size);
+        len = (size_t)size.QuadPart;
+        mapping = len ? CreateFileMappingA(file, nullptr, PAGE_READONLY, 0, 0, nullptr) : nullptr;
+        base = mapping ? MapViewOfFile(mapping, FILE_MAP_READ, 0, 0, 0) : nullptr;
+#else
+        int fd = open(path, O_RDONLY);
+        if (fd < 0) throw std::runtime_error("无法打开矩阵文件");
+        struct stat st;
+        fstat(fd, &st);
+        len = (size_t)st.st_size;
+        base = len ? mmap(nullptr, len, PROT_READ, MAP_SHARED, fd, 0) : MAP_FAILED;
+        close(fd);
+        if (base == MAP_FAILED) base = nullptr;
+#endif
+        try {
+            if (base == nullptr || len < sizeof(MatFileHeader)) throw std::runtime_error("矩阵文件映射失败");
+            MatFileHeader h;
+            memcpy(&h, base, sizeof(h));
+            if (matFileCheckHeader<T>(h)) throw std::runtime_error("矩阵文件字节序与本机不同，不能映射");
+            if (h.offset % alignof(T) != 0 || h.offset > len
+                || (h.rows != 0 && (len - h.offset) / sizeof(T) / h.rows < h.stride))
+                throw std::runtime_error("矩阵文件数据不完整");
+            v = MatView<const T>(reinterpret_cast<const T*>(static_cast<const char*>(base) + h.offset),
+                (int)h.rows, (int)h.cols, (int)h.stride);
+        }
+        catch (...) {
+            unmap();
+            throw;
+        }
+    }
+    MappedMAT(const MappedMAT&) = delete;
+    MappedMAT& operator=(const MappedMAT&) = delete;
+    ~MappedMAT() noexcept { unmap(); }
+
+    MatView<const T> view() const { return v; }
+    operator MatView<const T>() const { return v; }
+    // 行数
+    int rows() const { return v.rows(); }
+    // 列数
+    int cols() const { return v.cols(); }
+};
+
+// 矩阵文件测试: 保存、读入、映射后与原矩阵对比
+void testMatFile() {
+    const char* path = "exp5_mat_test.bin";
+    MAT<double> a(3, 5);
+    for (int i = 0; i < 3; ++i) for (int j = 0; j < 5; ++j) a[i][j] = i * 0.5 - j;
+    try {
+        matSave(a, path);
+        MAT<double> b = matLoad<double>(path);
+        MappedMAT<double> m(path);
+        bool ok = b.rows() == 3 && b.cols() == 5 && m.rows() == 3 && m.cols() == 5;
+        for (int i = 0; i < 3 && ok; ++i) for (int j = 0; j < 5; ++j)
+            ok = ok && b[i][j] == a[i][j] && m.view()[i][j] == a[i][j];
+        MAT<double> p = m.view() * ~a; // 映射的矩阵直接参与运算
+        ok = ok && p[1][2] == (a * ~a)[1][2];
+        cout << (ok ? "矩阵文件读写正确" : "矩阵文件读写错误") << endl;
+        matLoad<float>(path);
+    }
+    catch (const std::exception& ex) {
+        std::cout << "异常: " << ex.what() << std::endl;
+    }
+    remove(path);
+}
+
+// 矩阵文件基准: 大矩阵的保存、读入与映射耗时
+void benchMatFile(int n) {
+    const char* path = "exp5_mat_bench.bin";
+    MAT<double> a(n, n);
+    for (int i = 0; i < n; ++i) for (int j = 0; j < n; ++j) a[i][j] = i + j;
+    auto t0 = std::chrono::steady_clock::now();
+    matSave(a, path);
+    auto t1 = std::chrono::steady_clock::now();
+    MAT<double> b = matLoad<double>(path);
+    auto t2 = std::chrono::steady_clock::now();
+    double s = 0;
+    {
+        MappedMAT<double> m(path);
+        auto t3 = std::chrono::steady_clock::now();
+        s = m.view()[n - 1][n - 1];
+        cout << "矩阵文件 " << n << "x" << n << " (" << (double)n * n * sizeof(double) / (1 << 20) << " MB)"
+             << "  保存 " << std::chrono::duration<double, std::milli>(t1 - t0).count() << " ms"
+             << "  读入 " << std::chrono::duration<double, std::milli>(t2 - t1).count() << " ms"
+             << "  映射 " << std::chrono::duration<double, std::milli>(t3 - t2).count() << " ms" << endl;
+    }
+    if (s != b[n - 1][n - 1]) cout << "映射结果错误" << endl;
+    remove(path);
+}
+
+// 格式化测试: 有界缓冲区截断、字符串与流输出一致
+void testMatFormat() {
+    MAT<int> a(2, 3);
+    a[0][0] = 1; a[0][1] = -20; a[0][2] = 300;
+    a[1][0] = 123456789; a[1][1] = 0; a[1][2] = -7;
+    char small[16];
+    size_t need = a.print(small, sizeof(small));
+    std::string s1 = a.str(), s2 = a.str(2);
+    std::ostringstream os;
+    os << a;
+    cout << "所需长度 " << need << " 截断为 \"" << small << "\"" << endl;
+    cout << s1;
+    cout << (need == s1.size() && s1 == s2 && s1 == os.str() && s1.compare(0, 15, small) == 0
+        ? "格式化一致" : "格式化不一致") << endl;
+    MAT<double> f(1, 2);
+    f[0][0] = 3.14159; f[0][1] = -1e10;
+    cout << f.str();
+}
+
+// 格式化基准: 旧的sprintf+strcat与一遍格式化的耗时对比
+void benchMatFormat() {
+    const int n = 300;
+    MAT<double> a(n, n);
+    for (int i = 0; i < n; ++i) for (int j = 0; j < n; ++j) a[i][j] = (i - j) * 1.25;
+    std::vector<char> big((size_t)n * n * 20 + 1);
+    auto t0 = std::chrono::steady_clock::now();
+    big[0] = 0;
+    char buf[128];
+    for (int i = 0; i < n; ++i) for (int j = 0; j < n; ++j) {
+        sprintf(buf, "%8lf", a[i][j]);
+        strcat(big.data(), buf);
+        strcat(big.data(), j != n - 1 ? " " : "\n");
+    }
+    auto t1 = std::chrono::steady_clock::now();
+    std::string s = a.str();
+    auto t2 = std::chrono::steady_clock::now();
+    cout << "格式化 " << n << "x" << n << "  sprintf+strcat " << std::chrono::duration<double, std::milli>(t1 - t0).count()
+         << " ms  to_chars " << std::chrono::duration<double, std::milli>(t2 - t1).count() << " ms"
+         << (s == big.data() ? "" : "  (输出不一致)") << endl;
+    const int m = 3000;
+    MAT<double> b(m, m);
+    for (int i = 0; i < m; ++i) for (int j = 0; j < m; ++j) b[i][j] = (i - j) * 1.25;
+    for (int threads : { 1, 4 }) {
+        auto t3 = std::chrono::steady_clock::now();
+        size_t len = b.str(threads).size();
+        auto t4 = std::chrono::steady_clock::now();
+        double ms = std::chrono::duration<double, std::milli>(t4 - t3).count();
+        cout << "格式化 " << m << "x" << m << "  " << threads << "线程 " << ms << " ms  "
+             << len / ms / 1000 << " MB/s" << endl;
+    }
+}
+
+// 小矩阵批: count个R×C矩阵按结构数组存放，各矩阵的元素(i, j)连续排在一起
+// 批量运算的最内层循环遍历矩阵序号，一个SIMD通道正好处理一个矩阵；结果写入预先分配的批，运算本身不分配内存
+template <typename T, int R, int C>
+class MatBatch {
+    static_assert(R > 0 && C > 0, "批内矩阵维度必须为正");
+    T* e;
+    size_t n;   // 矩阵个数
+    size_t ld;  // 相邻元素平面的间距，补齐到缓存行
+
+    template <typename, int, int> friend class MatBatch;
+public:
+    static constexpr size_t ALIGN = 64;
+
+    explicit MatBatch(size_t count) : e(nullptr), n(count), ld(count) {
+        if (ALIGN % sizeof(T) == 0) {
+            const size_t per = ALIGN / sizeof(T);
+            ld = (count + per - 1) / per * per;
+        }
+        e = static_cast<T*>(::operator new(matCheckedMul(matCheckedMul(ld, R * C), sizeof(T)), std::align_val_t(ALIGN)));
+        std::uninitialized_value_construct_n(e, ld * R * C);
+    }
+    MatBatch(const MatBatch&) = delete;
+    MatBatch& operator=(const MatBatch&) = delete;
+    ~MatBatch() noexcept {
+        std::destroy_n(e, ld * R * C);
+        ::operator delete(e, std::align_val_t(ALIGN));
+    }
+
+    // 元素(i, j)的平面: 依次是各矩阵的该元素
+    T* plane(int i, int j) { return e + (size_t)(i * C + j) * ld; }
+    const T* plane(int i, int j) const { return e + (size_t)(i * C + j) * ld; }
+
+    // 取出/放入第b个矩阵
+    MAT<T, R, C> get(size_t b) const {
+        if (b >= n) throw std::out_of_range("批内序号越界");
+        MAT<T, R, C> m;
+        for (int i = 0; i < R; ++i) for (int j = 0; j < C; ++j) m[i][j] = plane(i, j)[b];
+        return m;
+    }
+    void set(size_t b, const MAT<T, R, C>& m) {
+        if (b >= n) throw std::out_of_range("批内序号越界");
+        for (int i = 0; i < R; ++i) for (int j = 0; j < C; ++j) plane(i, j)[b] = m[i][j];
+    }
+
+    // 矩阵个数
+    size_t size() const { return n; }
+};
+
+// o[b] = Σk ap[k][b] * xp[k][b]，k方向在编译期展开，b方向可直接向量化
+template <typename T, size_t... K>
+void batchDotRange(const T* const* ap, const T* const* xp, T* __restrict o, size_t b0, size_t b1, std::index_sequence<K...>) {
+    const T* __restrict a[] = { ap[K]... };
+    const T* __restrict x[] = { xp[K]... };
+    size_t b = b0;
+#if defined(MAT_SIMD_AVX)
+    if constexpr (std::is_same<T, float>::value) {
+        for (; b + 8 <= b1; b += 8) {
+            __m256 s = _mm256_setzero_ps();
+            ((s = _mm256_add_ps(s, _mm256_mul_ps(_mm256_loadu_ps(a[K] + b), _mm256_loadu_ps(x[K] + b)))), ...);
+            _mm256_storeu_ps(o + b, s);
+        }
+    }
+    else if constexpr (std::is_same<T, double>::value) {
+        for (; b + 4 <= b1; b += 4) {
+            __m256d s = _mm256_setzero_pd();
+            ((s = _mm256_add_pd(s, _mm256_mul_pd(_mm256_loadu_pd(a[K] + b), _mm256_loadu_pd(x[K] + b)))), ...);
+            _mm256_storeu_pd(o + b, s);
+        }
+    }
+#elif defined(MAT_SIMD_SSE2)
+    if constexpr (std::is_same<T, float>::value) {
+        for (; b + 4 <= b1; b += 4) {
+            __m128 s = _mm_setzero_ps();
+            ((s = _mm_add_ps(s, _mm_mul_ps(_mm_loadu_ps(a[K] + b), _mm_loadu_ps(x[K] + b)))), ...);
+            _mm_storeu_ps(o + b, s);
+        }
+    }
+    else if constexpr (std::is_same<T, double>::value) {
+        for (; b + 2 <= b1; b += 2) {
+            __m128d s = _mm_setzero_pd();
+            ((s = _mm_add_pd(s, _mm_mul_pd(_mm_loadu_pd(a[K] + b), _mm_loadu_pd(x[K] + b)))), ...);
+            _mm_storeu_pd(o + b, s);
+        }
+    }
+#endif
+    for (; b < b1; ++b)
+        o[b] = ((a[K][b] * x[K][b]) + ...);
+}
+
+// 批量乘法: out[b] = a[b] * x[b]
+// 按BS个矩阵分段，段内各平面片段常驻缓存；k方向在寄存器中累加，每个结果元素只写一次
+template <typename T, int R, int C, int K>
+void batchMul(const MatBatch<T, R, C>& a, const MatBatch<T, C, K>& x, MatBatch<T, R, K>& out) {
+    const size_t n = a.size();
+    if (x.size() != n || out.size() != n) throw std::invalid_argument("批量乘法个数不符");
+    if ((const void*)&out == (const void*)&a || (const void*)&out == (const void*)&x)
+        throw std::invalid_argument("批量乘法结果不能与操作数相同");
+    const size_t BS = 1024;
+    for (size_t b0 = 0; b0 < n; b0 += BS) {
+        const size_t b1 = std::min(n, b0 + BS);
+        for (int i = 0; i < R; ++i) {
+            for (int j = 0; j < K; ++j) {
+                const T* ap[C];
+                const T* xp[C];
+                for (int k = 0; k < C; ++k) {
+                    ap[k] = a.plane(i, k);
+                    xp[k] = x.plane(k, j);
+                }
+                batchDotRange(ap, xp, out.plane(i, j), b0, b1, std::make_index_sequence<C>{});
+            }
+        }
+    }
+}
+
+// 批量加法: out[b] = a[b] + x[b]，out可与操作数相同
+template <typename T, int R, int C>
+void batchAdd(const MatBatch<T, R, C>& a, const MatBatch<T, R, C>& x, MatBatch<T, R, C>& out) {
+    const size_t n = a.size();
+    if (x.size() != n || out.size() != n) throw std::invalid_argument("批量加法个数不符");
+    for (int i = 0; i < R; ++i) {
+        for (int j = 0; j < C; ++j) {
+            T* o = out.plane(i, j);
+            const T* p = a.plane(i, j);
+            const T* q = x.plane(i, j);
+            for (size_t b = 0; b < n; ++b) o[b] = p[b] + q[b];
+        }
+    }
+}
+
+// 批量转置: out[b] = ~a[b]；只是平面间的整块复制
+template <typename T, int R, int C>
+void batchTranspose(const MatBatch<T, R, C>& a, MatBatch<T, C, R>& out) {
+    if (out.size() != a.size()) throw std::invalid_argument("批量转置个数不符");
+    if ((const void*)&out == (const void*)&a) throw std::invalid_argument("批量转置结果不能与操作数相同");
+    for (int i = 0; i < R; ++i)
+        for (int j = 0; j < C; ++j)
+            std::copy_n(a.plane(i, j), a.size(), out.plane(j, i));
+}
+
+// 小矩阵批测试: 与逐个定长矩阵运算的结果对比
+void testMatBatch() {
+    const size_t n = 37;
+    MatBatch<float, 3, 3> a(n), x(n), p(n), s(n), t(n);
+    for (size_t b = 0; b < n; ++b) {
+        MAT<float, 3, 3> m, k;
+        for (int i = 0; i < 3; ++i) for (int j = 0; j < 3; ++j) {
+            m[i][j] = float(b + i * 3 + j);
+            k[i][j] = float((b % 5) - i + j);
+        }
+        a.set(b, m);
+        x.set(b, k);
+    }
+    batchMul(a, x, p);
+    batchAdd(a, x, s);
+    batchTranspose(a, t);
+    bool ok = true;
+    for (size_t b = 0; b < n; ++b) {
+        MAT<float, 3, 3> m = a.get(b), k = x.get(b);
+        ok = ok && p.get(b) == m * k && s.get(b) == m + k && t.get(b) == ~m;
+    }
+    cout << (ok ? "小矩阵批运算正确" : "小矩阵批运算错误") << endl;
+}
+
+// 小矩阵批基准: 4x4 float乘法，逐个动态矩阵、逐个定长矩阵与批量运算的单个耗时；批常驻缓存，重复reps遍
+void benchMatBatch() {
+    const size_t n = 4096, reps = 256;
+    MatBatch<float, 4, 4> a(n), x(n), out(n);
+    for (int i = 0; i < 4; ++i) for (int j = 0; j < 4; ++j)
+        for (size_t b = 0; b < n; ++b) {
+            a.plane(i, j)[b] = float((b + i) % 7);
+            x.plane(i, j)[b] = float((b + j) % 5);
+        }
+    std::vector<MAT<float, 4, 4>> fa(n), fx(n), fo(n);
+    for (size_t b = 0; b < n; ++b) {
+        fa[b] = a.get(b);
+        fx[b] = x.get(b);
+    }
+    const size_t dn = n * 16;
+    MAT<float> da(4, 4), dx(4, 4);
+    float sink = 0;
+    auto t0 = std::chrono::steady_clock::now();
+    for (size_t b = 0; b < dn; ++b) {
+        da[0][0] = float(b);
+        MAT<float> d = da * dx;
+        sink += d[0][0];
+    }
+    auto t1 = std::chrono::steady_clock::now();
+    for (size_t r = 0; r < reps; ++r)
+        for (size_t b = 0; b < n; ++b) fo[b] = fa[b] * fx[b];
+    auto t2 = std::chrono::steady_clock::now();
+    for (size_t r = 0; r < reps; ++r) batchMul(a, x, out);
+    auto t3 = std::chrono::steady_clock::now();
+    auto ns = [](std::chrono::steady_clock::duration d, size_t cnt) {
+        return std::chrono::duration<double, std::nano>(d).count() / cnt;
+    };
+    cout << "4x4 float乘法(每个)  动态MAT " << ns(t1 - t0, dn) << " ns  定长MAT " << ns(t2 - t1, n * reps)
+         << " ns  批量 " << ns(t3 - t2, n * reps) << " ns" << (out.get(n - 1) == fo[n - 1] ? "" : "  (结果不一致)")
+         << (sink < 0 ? " " : "") << endl;
+}
+
+// 整数矩阵乘法的宽结果类型: int8 → int32，int16/int32 → int64
+template <typename T>
+struct WideOf;
+template <>
+struct WideOf<int8_t> { using type = int32_t; };
+template <>
+struct WideOf<int16_t> { using type = int64_t; };
+template <>
+struct WideOf<int32_t> { using type = int64_t; };
+
+// 由int8扩展来的int16向量点积: pmaddwd把相邻两对乘积相加为int32(不超过2^15)，
+// 每段至多65536个元素在int32通道内累加，段间累加到int64，任意长度都精确
+inline long long dotI8(const int16_t* x, const int16_t* y, int len) {
+    long long total = 0;
+    int p = 0;
+    while (p < len) {
+        const int end = std::min(len, p + 65536);
+        int32_t part = 0;
+#if defined(MAT_SIMD_AVX) && defined(__AVX2__)
+        __m256i acc = _mm256_setzero_si256();
+        for (; p + 16 <= end; p += 16) {
+            __m256i u = _mm256_loadu_si256((const __m256i*)(x + p));
+            __m256i v = _mm256_loadu_si256((const __m256i*)(y + p));
+#if defined(__AVX512VNNI__) && defined(__AVX512VL__)
+            acc = _mm256_dpwssd_epi32(acc, u, v);
+#elif defined(__AVXVNNI__)
+            acc = _mm256_dpwssd_avx_epi32(acc, u, v);
+#else
+            acc = _mm256_add_epi32(acc, _mm256_madd_epi16(u, v));
+#endif
+        }
+        alignas(32) int32_t lanes[8];
+        _mm256_store_si256((__m256i*)lanes, acc);
+        for (int t = 0; t < 8; ++t) part += lanes[t];
+#elif defined(MAT_SIMD_SSE2) || defined(MAT_SIMD_AVX)
+        __m128i acc = _mm_setzero_si128();
+        for (; p + 8 <= end; p += 8) {
+            __m128i u = _mm_loadu_si128((const __m128i*)(x + p));
+            __m128i v = _mm_loadu_si128((const __m128i*)(y + p));
+            acc = _mm_add_epi32(acc, _mm_madd_epi16(u, v));
+        }
+        alignas(16) int32_t lanes[4];
+        _mm_store_si128((__m128i*)lanes, acc);
+        for (int t = 0; t < 4; ++t) part += lanes[t];
+#endif
+        for (; p < end; ++p) part += (int32_t)x[p] * y[p];
+        total += part;
+    }
+    return total;
+}
+
+// 整数矩阵乘法核: 以转置打包的B按行做点积，把(i, j)处的精确和交给store(i, j, lo, hi)
+// 精确和为 hi·2^64 + (unsigned)lo；只有int32输入才可能超出int64，此时hi另有进位
+template <typename T, typename Store>
+void matMulIntKernel(MatView<const T> a, MatView<const T> b, Store&& store) {
+    static_assert(std::is_same<T, int8_t>::value || std::is_same<T, int16_t>::value || std::is_same<T, int32_t>::value,
+        "整数矩阵乘法只支持int8/int16/int32");
+    if (a.cols() != b.rows()) throw std::invalid_argument("矩阵乘法维度不符");
+    const int m = a.rows(), k = a.cols(), n = b.cols();
+    using P = typename std::conditional<sizeof(T) == 4, int32_t, int16_t>::type;
+    std::vector<P> bt((size_t)n * k);
+    for (int p = 0; p < k; ++p) {
+        const T* bp = b[p];
+        for (int j = 0; j < n; ++j) bt[(size_t)j * k + p] = bp[j];
+    }
+    std::vector<P> ai(k);
+    for (int i = 0; i < m; ++i) {
+        std::copy_n(a[i], k, ai.data());
+        for (int j = 0; j < n; ++j) {
+            const P* bj = bt.data() + (size_t)j * k;
+            if constexpr (sizeof(T) == 1) {
+                long long s = dotI8(ai.data(), bj, k);
+                store(i, j, s, s < 0 ? -1LL : 0LL);
+            }
+            else if constexpr (sizeof(T) == 2) {
+                long long s = 0;
+                for (int p = 0; p < k; ++p) s += (long long)ai[p] * bj[p];
+                store(i, j, s, s < 0 ? -1LL : 0LL);
+            }
+            else {
+                // 128位累加: 每个乘积都在int64内，只需跟踪低64位的进位
+                unsigned long long lo = 0;
+                long long hi = 0;
+                for (int p = 0; p < k; ++p) {
+                    const long long prod = (long long)ai[p] * bj[p];
+                    const unsigned long long sum = lo + (unsigned long long)prod;
+                    hi += (prod < 0 ? -1 : 0) + (sum < lo ? 1 : 0);
+                    lo = sum;
+                }
+                store(i, j, (long long)lo, hi);
+            }
+        }
+    }
+}
+
+// 把精确和限制到W的取值范围；超出时sat为false则抛异常
+template <typename W>
+W clampWide(long long lo, long long hi, bool sat) {
+    const long long sign = lo < 0 ? -1 : 0;
+    long long v = lo;
+    bool over = false;
+    if (hi != sign) {
+        over = true;
+        v = hi < 0 ? LLONG_MIN : LLONG_MAX;
+    }
+    if (v > (long long)std::numeric_limits<W>::max()) {
+        over = true;
+        v = std::numeric_limits<W>::max();
+    }
+    else if (v < (long long)std::numeric_limits<W>::min()) {
+        over = true;
+        v = std::numeric_limits<W>::min();
+    }
+    if (over && !sat) throw std::overflow_error("整数矩阵乘法结果溢出");
+    return (W)v;
+}
+
+// 加宽乘法: 紧凑存储的整数矩阵相乘，结果为宽类型，精确无溢出；结果超出宽类型时抛异常
+template <typename T>
+MAT<typename WideOf<T>::type> matMulWide(MatView<const T> a, MatView<const T> b) {
+    using W = typename WideOf<T>::type;
+    MAT<W> res(a.rows(), b.cols());
+    matMulIntKernel(a, b, [&](int i, int j, long long lo, long long hi) { res[i][j] = clampWide<W>(lo, hi, false); });
+    return res;
+}
+template <typename T>
+MAT<typename WideOf<T>::type> matMulWide(const MAT<T>& a, const MAT<T>& b) {
+    return matMulWide(a.view(), b.view());
+}
+
+// 饱和乘法: 以宽类型精确累加，结果饱和到存储类型的范围
+template <typename T>
+MAT<T> matMulSat(MatView<const T> a, MatView<const T> b) {
+    MAT<T> res(a.rows(), b.cols());
+    matMulIntKernel(a, b, [&](int i, int j, long long lo, long long hi) { res[i][j] = clampWide<T>(lo, hi, true); });
+    return res;
+}
+template <typename T>
+MAT<T> matMulSat(const MAT<T>& a, const MAT<T>& b) {
+    return matMulSat(a.view(), b.view());
+}
+
+// 整数乘法测试: 与long long逐元素计算对比，检查饱和与溢出
+void testMatMulInt() {
+    const int m = 3, k = 300, n = 4;
+    MAT<int8_t> a(m, k), b(k, n);
+    MAT<long long> ra(m, k), rb(k, n);
+    for (int i = 0; i < m; ++i) for (int p = 0; p < k; ++p) ra[i][p] = a[i][p] = int8_t(i == 0 ? -128 : (p * 37 + i) % 256 - 128);
+    for (int p = 0; p < k; ++p) for (int j = 0; j < n; ++j) rb[p][j] = b[p][j] = int8_t(j == 0 ? -128 : (p * 11 + j * 5) % 256 - 128);
+    MAT<int32_t> w = matMulWide(a, b);
+    MAT<long long> ref = ra * rb;
+    MAT<int8_t> s = matMulSat(a, b);
+    bool ok = true;
+    for (int i = 0; i < m; ++i) for (int j = 0; j < n; ++j) {
+        ok = ok && w[i][j] == ref[i][j];
+        ok = ok && s[i][j] == (int8_t)std::max(-128LL, std::min(127LL, ref[i][j]));
+    }
+    cout << "int8乘法 (0,0)=" << w[0][0] << (ok ? " 加宽/饱和结果正确" : " 加宽/饱和结果错误") << endl;
+
+    MAT<int32_t> x(1, 4), y(4, 1);
+    for (int p = 0; p < 4; ++p) { x[0][p] = INT_MIN; y[p][0] = INT_MIN; }
+    cout << "int32饱和: " << matMulSat(x, y)[0][0] << endl;
+    try {
+        matMulWide(x, y); // 4·2^62 超出int64
+    }
+    catch (const std::exception& ex) {
+        std::cout << "异常: " << ex.what() << std::endl;
+    }
+}
+
+// 整数乘法基准: int8存储加宽乘法与MAT<long long>普通乘法的耗时
+void benchMatMulInt(int n) {
+    MAT<int8_t> a(n, n), b(n, n);
+    MAT<long long> la(n, n), lb(n, n);
+    for (int i = 0; i < n; ++i) for (int j = 0; j < n; ++j) {
+        la[i][j] = a[i][j] = int8_t((i * 31 + j * 17) % 256 - 128);
+        lb[i][j] = b[i][j] = int8_t((i * 13 + j * 7) % 256 - 128);
+    }
+    auto t0 = std::chrono::steady_clock::now();
+    MAT<int32_t> w = matMulWide(a, b);
+    auto t1 = std::chrono::steady_clock::now();
+    MAT<long long> l = la * lb;
+    auto t2 = std::chrono::steady_clock::now();
+    cout << "整数乘法 " << n << "x" << n << "  int8加宽 " << std::chrono::duration<double, std::milli>(t1 - t0).count()
+         << " ms  long long " << std::chrono::duration<double, std::milli>(t2 - t1).count() << " ms"
+         << (w[n - 1][n - 1] == l[n - 1][n - 1] ? "" : "  (结果不一致)") << endl;
+}
+
+// 融合乘加测试: 四种转置组合与先乘再加的结果对比，beta为0时忽略C中的NaN
+void testGemm() {
+    MAT<double> a(3, 4), at(4, 3), b(4, 2), bt(2, 4), c(3, 2), ref(3, 2);
+    for (int i = 0; i < 3; ++i) for (int j = 0; j < 4; ++j) at[j][i] = a[i][j] = i * 4 + j - 5;
+    for (int i = 0; i < 4; ++i) for (int j = 0; j < 2; ++j) bt[j][i] = b[i][j] = (i + 1) * (j - 0.5);
+    for (int i = 0; i < 3; ++i) for (int j = 0; j < 2; ++j) ref[i][j] = i - j;
+    MAT<double> expect = 2.0 * (a * b) + ref * 0.5;
+    bool ok = true;
+    for (int t = 0; t < 4; ++t) {
+        c = ref;
+        gemm(2.0, t & 1 ? at : a, t & 1, t & 2 ? bt : b, (t & 2) != 0, 0.5, c);
+        for (int i = 0; i < 3; ++i) for (int j = 0; j < 2; ++j) ok = ok && std::fabs(c[i][j] - expect[i][j]) < 1e-12;
+    }
+    for (int i = 0; i < 3; ++i) for (int j = 0; j < 2; ++j) c[i][j] = NAN;
+    gemm(1.0, a, b, 0.0, c);
+    MAT<double> ab = a * b;
+    for (int i = 0; i < 3; ++i) for (int j = 0; j < 2; ++j) ok = ok && c[i][j] == ab[i][j];
+
+    // 子块上的axpy/scal: c的第0列 = 3·c的第0列 - ab的第1列
+    scal(3.0, c.colRange(0, 1));
+    axpy(-1.0, ab.colRange(1, 1), c.colRange(0, 1));
+    for (int i = 0; i < 3; ++i) ok = ok && c[i][0] == 3 * ab[i][0] - ab[i][1] && c[i][1] == ab[i][1];
+    c *= 2.0;
+    ok = ok && c[2][1] == 2 * ab[2][1];
+    cout << (ok ? "gemm/axpy/scal结果正确" : "gemm/axpy/scal结果错误") << endl;
+    try {
+        gemm(1.0, a, true, b, false, 0.0, c);
+    }
+    catch (const std::exception& ex) {
+        std::cout << "异常: " << ex.what() << std::endl;
+    }
+}
+
+// 融合乘加基准: 迭代更新C += A·B与C = 0.5·C + 2·X，对比运算符写法(每步产生临时矩阵)与就地更新
+void benchGemm(int n, int steps) {
+    MAT<double> a(n, n), b(n, n), x(n, n), c1(n, n), c2(n, n);
+    for (int i = 0; i < n; ++i) for (int j = 0; j < n; ++j) {
+        a[i][j] = ((i * 31 + j * 17) % 97) / 97.0 - 0.5;
+        b[i][j] = ((i * 13 + j * 7) % 89) / 89.0 - 0.5;
+        x[i][j] = ((i + j) % 11) / 11.0;
+    }
+    auto ms = [](std::chrono::steady_clock::time_point t0, std::chrono::steady_clock::time_point t1) {
+        return std::chrono::duration<double, std::milli>(t1 - t0).count();
+    };
+    auto t0 = std::chrono::steady_clock::now();
+    for (int s = 0; s < steps; ++s) c1 = c1 + a * b;                // a*b与和各一个临时矩阵
+    auto t1 = std::chrono::steady_clock::now();
+    for (int s = 0; s < steps; ++s) gemm(1.0, a, b, 1.0, c2);
+    auto t2 = std::chrono::steady_clock::now();
+    double diff = 0;
+    for (int i = 0; i < n; ++i) for (int j = 0; j < n; ++j) diff = std::max(diff, std::fabs(c1[i][j] - c2[i][j]));
+    cout << "gemm " << n << "x" << n << " ×" << steps << "  C=C+A*B " << ms(t0, t1) << " ms  融合 " << ms(t1, t2)
+         << " ms  少分配" << 2 * steps << "个临时矩阵  最大差 " << diff << endl;
+
+    const int reps = steps * 20;
+    t0 = std::chrono::steady_clock::now();
+    for (int s = 0; s < reps; ++s) c1 = c1 * 0.5 + x * 2.0;       // 三个临时矩阵
+    t1 = std::chrono::steady_clock::now();
+    for (int s = 0; s < reps; ++s) { scal(0.5, c2); axpy(2.0, x, c2); }
+    t2 = std::chrono::steady_clock::now();
+    diff = 0;
+    for (int i = 0; i < n; ++i) for (int j = 0; j < n; ++j) diff = std::max(diff, std::fabs(c1[i][j] - c2[i][j]));
+    cout << "axpy/scal " << n << "x" << n << " ×" << reps << "  运算符 " << ms(t0, t1) << " ms  就地 " << ms(t1, t2)
+         << " ms  少分配" << 3 * reps << "个临时矩阵  最大差 " << diff << endl;
+}
+
+// 矩阵幂与连乘的统计
+struct MatChainStats {
+    long long multiplies = 0;  // 矩阵乘法次数
+    long long flops = 0;       // 标量乘法次数
+    long long naiveFlops = 0;  // 逐个相乘(a·a·…·a或从左到右连乘)的标量乘法次数
+    int allocs = 0;            // 实际分配的矩阵缓冲区数
+    int allocsAvoided = 0;     // 同一计算次序用运算符写法(每次乘法一个临时矩阵)应多分配的次数
+};
+
+// 矩阵幂: 平方求幂，结果、底数与一块暂存区共三块缓冲区一次分配，乘积在其间轮换，不再分配
+template <typename T>
+MAT<T> pow(const MAT<T>& a, long long k, MatChainStats* st = nullptr) {
+    if (a.rows() != a.cols()) throw std::invalid_argument("矩阵幂须为方阵");
+    if (k < 0) throw std::invalid_argument("矩阵幂次不能为负");
+    const int n = a.rows();
+    MatChainStats s;
+    s.naiveFlops = k > 1 ? (k - 1) * n * n * (long long)n : 0;
+    MAT<T> m0(n, n), m1(a), m2(n, n);
+    MAT<T>* res = &m0;
+    MAT<T>* base = &m1;
+    MAT<T>* tmp = &m2;
+    s.allocs = 3;
+    bool first = true; // 结果尚为单位阵: 首次直接取底数，省去一次乘法
+    auto mul = [&](const MAT<T>& x, const MAT<T>& y) {
+        matKernel(x.data(), x.stride(), y.data(), y.stride(), tmp->data(), tmp->stride(), n, n, n);
+        ++s.multiplies;
+    };
+    for (long long e = k; e > 0; e >>= 1) {
+        if (e & 1) {
+            if (first) *res = *base;
+            else { mul(*res, *base); std::swap(res, tmp); }
+            first = false;
+        }
+        if (e > 1) { mul(*base, *base); std::swap(base, tmp); }
+    }
+    if (first) for (int i = 0; i < n; ++i) (*res)[i][i] = 1;
+    s.flops = s.multiplies * n * n * (long long)n;
+    s.allocsAvoided = (int)s.multiplies + 2 - s.allocs;
+    if (st) *st = s;
+    return std::move(*res);
+}
+
+// 矩阵连乘: 按维度动态规划求标量乘法最少的加括号方式，再按此次序计算
+// 中间结果放在按最大中间结果大小分配的缓冲池中，用完即归还复用；最终乘积直接写入结果
+template <typename T>
+MAT<T> matChain(const std::vector<MatView<const T>>& ms, MatChainStats* st = nullptr) {
+    const int n = (int)ms.size();
+    if (n == 0) throw std::invalid_argument("矩阵连乘至少需要一个矩阵");
+    std::vector<long long> d(n + 1);
+    d[0] = ms[0].rows();
+    for (int i = 0; i < n; ++i) {
+        if (ms[i].rows() != d[i]) throw std::invalid_argument("矩阵连乘维度不符");
+        d[i + 1] = ms[i].cols();
+    }
+    // cost[i][j]: 计算ms[i..j]的最少标量乘法次数；split[i][j]: 最优分割点
+    std::vector<std::vector<long long>> cost(n, std::vector<long long>(n, 0));
+    std::vector<std::vector<int>> split(n, std::vector<int>(n, 0));
+    for (int len = 2; len <= n; ++len)
+        for (int i = 0; i + len - 1 < n; ++i) {
+            const int j = i + len - 1;
+            cost[i][j] = LLONG_MAX;
+            for (int q = i; q < j; ++q) {
+                const long long v = cost[i][q] + cost[q + 1][j] + d[i] * d[q + 1] * d[j + 1];
+                if (v < cost[i][j]) { cost[i][j] = v; split[i][j] = q; }
+            }
+        }
+    MatChainStats s;
+    s.flops = cost[0][n - 1];
+    for (int i = 1; i < n; ++i) s.naiveFlops += d[0] * d[i] * d[i + 1];
+    s.multiplies = n - 1;
+
+    // 中间结果的最大元素个数，池中缓冲区统一按此大小分配
+    size_t maxElems = 0;
+    for (int i = 0; i < n; ++i)
+        for (int j = i + 1; j < n; ++j)
+            if (i != 0 || j != n - 1) maxElems = std::max(maxElems, (size_t)(d[i] * d[j + 1]));
+    std::vector<std::unique_ptr<T[]>> pool;
+    std::vector<T*> freeList;
+    auto acquire = [&]() {
+        if (freeList.empty()) {
+            pool.emplace_back(new T[maxElems]);
+            freeList.push_back(pool.back().get());
+        }
+        T* p = freeList.back();
+        freeList.pop_back();
+        return p;
+    };
+
+    MAT<T> res(d[0], d[n]);
+    s.allocs = 1;
+    // 计算ms[i..j]之积写入out
+    std::function<void(int, int, T*, int)> run = [&](int i, int j, T* out, int ldo) {
+        if (i == j) {
+            for (int r = 0; r < ms[i].rows(); ++r) std::copy_n(ms[i][r], ms[i].cols(), out + (size_t)r * ldo);
+            return;
+        }
+        const int q = split[i][j];
+        // 单个矩阵直接作操作数，否则先算进池中的缓冲区(行跨度取列数)
+        auto operand = [&](int x, int y, const T*& p, int& ld) -> T* {
+            if (x == y) { p = ms[x].data(); ld = ms[x].stride(); return nullptr; }
+            T* buf = acquire();
+            ld = (int)d[y + 1];
+            run(x, y, buf, ld);
+            p = buf;
+            return buf;
+        };
+        const T* pl;
+        const T* pr;
+        int ldl, ldr;
+        T* bl = operand(i, q, pl, ldl);
+        T* br = operand(q + 1, j, pr, ldr);
+        matKernel(pl, ldl, pr, ldr, out, ldo, (int)d[i], (int)d[q + 1], (int)d[j + 1]);
+        if (bl) freeList.push_back(bl);
+        if (br) freeList.push_back(br);
+    };
+    run(0, n - 1, res.data(), res.stride());
+    s.allocs += (int)pool.size();
+    s.allocsAvoided = n - 1 - s.allocs;
+    if (st) *st = s;
+    return res;
+}
+
+// 矩阵幂与连乘测试: 与逐个相乘的结果对比
+void testMatPowChain() {
+    MAT<long long> a(3, 3);
+    for (int i = 0; i < 3; ++i) for (int j = 0; j < 3; ++j) a[i][j] = (i + 2 * j) % 3 - (i == j);
+    bool ok = true;
+    MAT<long long> naive(a);
+    for (int k = 1; k <= 20; ++k) {
+        if (k > 1) naive = naive * a;
+        MAT<long long> p = pow(a, k);
+        for (int i = 0; i < 3; ++i) for (int j = 0; j < 3; ++j) ok = ok && p[i][j] == naive[i][j];
+    }
+    MAT<long long> id = pow(a, 0);
+    ok = ok && id[0][0] == 1 && id[0][1] == 0 && id[2][2] == 1;
+    MatChainStats st;
+    pow(MAT<double>(a.rows(), a.cols()), 1000, &st);
+    cout << (ok ? "矩阵幂正确" : "矩阵幂错误") << "  a^1000: " << st.multiplies << "次乘法 少分配" << st.allocsAvoided << "次" << endl;
+
+    // 维度10×30、30×5、5×60、60×4: 最优次序远少于从左到右
+    const int dims[] = { 10, 30, 5, 60, 4 };
+    std::vector<MAT<double>> m;
+    for (int t = 0; t < 4; ++t) {
+        m.emplace_back(dims[t], dims[t + 1]);
+        for (int i = 0; i < dims[t]; ++i) for (int j = 0; j < dims[t + 1]; ++j) m[t][i][j] = ((i * 7 + j * 3 + t) % 5) - 2;
+    }
+    MAT<double> chain = matChain<double>({ m[0], m[1], m[2], m[3] }, &st);
+    MAT<double> ref = m[0] * m[1] * m[2] * m[3];
+    for (int i = 0; i < ref.rows(); ++i) for (int j = 0; j < ref.cols(); ++j) ok = ok && chain[i][j] == ref[i][j];
+    cout << (ok ? "矩阵连乘正确" : "矩阵连乘错误") << "  标量乘法 " << st.flops << " (从左到右 " << st.naiveFlops << ")" << endl;
+    try {
+        matChain<double>({ m[0], m[2] });
+    }
+    catch (const std::exception& ex) {
+        std::cout << "异常: " << ex.what() << std::endl;
+    }
+}
+
+// 矩阵幂与连乘基准: 对比运算符写法
+void benchMatPowChain() {
+    auto ms = [](std::chrono::steady_clock::time_point t0, std::chrono::steady_clock::time_point t1) {
+        return std::chrono::duration<double, std::milli>(t1 - t0).count();
+    };
+    // 8×8转移矩阵的1000次幂，重复多次: 矩阵小时分配与复制的开销才显著
+    const int n = 8, k = 1000, reps = 20000;
+    MAT<double> a(n, n);
+    for (int i = 0; i < n; ++i) for (int j = 0; j < n; ++j) a[i][j] = (i == j ? 0.5 : 0.5 / (n - 1));
+    auto t0 = std::chrono::steady_clock::now();
+    double chk0 = 0;
+    for (int r = 0; r < reps; ++r) {
+        MAT<double> res(a), base(a);
+        bool first = true;
+        for (long long e = k; e > 0; e >>= 1) {
+            if (e & 1) { if (first) res = base; else res *= base; first = false; }
+            if (e > 1) base *= base;
+        }
+        chk0 += res[0][0];
+    }
+    auto t1 = std::chrono::steady_clock::now();
+    double chk1 = 0;
+    MatChainStats st;
+    for (int r = 0; r < reps; ++r) chk1 += pow(a, k, &st)[0][0];
+    auto t2 = std::chrono::steady_clock::now();
+    cout << "矩阵幂 " << n << "x" << n << "^" << k << " ×" << reps << "  运算符 " << ms(t0, t1) << " ms  缓冲区轮换 "
+         << ms(t1, t2) << " ms  每次少分配" << st.allocsAvoided << "次" << (chk0 == chk1 ? "" : "  (结果不一致)") << endl;
+
+    // 维度差异悬殊的连乘
+    const int dims[] = { 400, 20, 400, 20, 400, 20, 400 };
+    std::vector<MAT<double>> m;
+    for (int t = 0; t < 6; ++t) {
+        m.emplace_back(dims[t], dims[t + 1]);
+        for (int i = 0; i < dims[t]; ++i) for (int j = 0; j < dims[t + 1]; ++j) m[t][i][j] = ((i + j + t) % 7) / 7.0;
+    }
+    t0 = std::chrono::steady_clock::now();
+    MAT<double> ref = m[0] * m[1] * m[2] * m[3] * m[4] * m[5];
+    t1 = std::chrono::steady_clock::now();
+    MAT<double> c = matChain<double>({ m[0], m[1], m[2], m[3], m[4], m[5] }, &st);
+    t2 = std::chrono::steady_clock::now();
+    cout << "矩阵连乘 6个  从左到右 " << ms(t0, t1) << " ms  最优次序 " << ms(t1, t2) << " ms  标量乘法 "
+         << st.naiveFlops << " -> " << st.flops << "  分配" << st.allocs << "次" << endl;
+}
+
+// 归约的累加类型: 整数累加到long long，浮点数按原类型累加
+template <typename T>
+using MatAccum = typename std::conditional<std::is_integral<T>::value, long long, T>::type;
+
+// 归约分块的元素数: 按行分块，块的划分只取决于矩阵形状而与线程数无关，
+// 各块部分结果按块序合并，故浮点求和结果不随线程数变化
+const int MAT_REDUCE_CHUNK = 1 << 14;
+// 行内归约的独立累加路数: 各路互不依赖，编译器可展开为向量指令，合并次序固定
+const int MAT_LANES = 8;
+
+// 按块把行区间[0,rows)分给threads个线程，fn(b, i0, i1)处理第b块
+template <typename F>
+void matParallelChunks(int rows, int per, int threads, F fn) {
+    const int chunks = (rows + per - 1) / per;
+    threads = std::max(1, std::min(threads, chunks));
+    auto work = [&](int t) {
+        const int b0 = (int)((long long)chunks * t / threads), b1 = (int)((long long)chunks * (t + 1) / threads);
+        for (int b = b0; b < b1; ++b) fn(b, b * per, std::min(rows, (b + 1) * per));
+    };
+    std::vector<std::thread> pool;
+    for (int t = 1; t < threads; ++t) pool.emplace_back(work, t);
+    work(0);
+    for (auto& th : pool) th.join();
+}
+
+// 分块归约: part(i0, i1)求行区间[i0,i1)的部分结果，各块结果按块序用comb合并；空矩阵返回A{}
+template <typename A, typename T, typename Part, typename Comb>
+A matReduceRows(MatView<const T> a, int threads, Part part, Comb comb) {
+    if (a.rows() == 0 || a.cols() == 0) return A{};
+    const int per = std::max(1, MAT_REDUCE_CHUNK / a.cols());
+    std::vector<A> parts((a.rows() + per - 1) / per);
+    matParallelChunks(a.rows(), per, threads, [&](int b, int i0, int i1) { parts[b] = part(i0, i1); });
+    A res = std::move(parts[0]);
+    for (size_t b = 1; b < parts.size(); ++b) res = comb(std::move(res), parts[b]);
+    return res;
+}
+
+// 一行上f(x)的多路累加
+template <typename A, typename T, typename F>
+inline A matLaneSum(const T* x, int n, F f) {
+    A acc[MAT_LANES] = {};
+    int j = 0;
+    for (; j + MAT_LANES <= n; j += MAT_LANES)
+        for (int l = 0; l < MAT_LANES; ++l) acc[l] += f(x[j + l]);
+    for (int l = 0; j < n; ++j, ++l) acc[l] += f(x[j]);
+    for (int w = MAT_LANES / 2; w > 0; w /= 2)
+        for (int l = 0; l < w; ++l) acc[l] += acc[l + w];
+    return acc[0];
+}
+
+// 一行的最大(greater为true)或最小值，n须大于0
+template <bool greater, typename T>
+inline T matLaneExtreme(const T* x, int n) {
+    T acc[MAT_LANES];
+    for (int l = 0; l < MAT_LANES; ++l) acc[l] = x[0];
+    int j = 0;
+    for (; j + MAT_LANES <= n; j += MAT_LANES)
+        for (int l = 0; l < MAT_LANES; ++l) acc[l] = (greater ? x[j + l] > acc[l] : x[j + l] < acc[l]) ? x[j + l] : acc[l];
+    for (; j < n; ++j) acc[0] = (greater ? x[j] > acc[0] : x[j] < acc[0]) ? x[j] : acc[0];
+    for (int l = 1; l < MAT_LANES; ++l) acc[0] = (greater ? acc[l] > acc[0] : acc[l] < acc[0]) ? acc[l] : acc[0];
+    return acc[0];
+}
+
+template <typename T>
+inline MatAccum<T> matAbs(T x) {
+    return x < 0 ? -(MatAccum<T>)x : (MatAccum<T>)x;
+}
+
+// 元素之和
+template <typename T>
+MatAccum<T> matSum(MatView<const T> a, int threads = 1) {
+    using A = MatAccum<T>;
+    return matReduceRows<A>(a, threads, [&](int i0, int i1) {
+        A s = 0;
+        for (int i = i0; i < i1; ++i) s += matLaneSum<A>(a[i], a.cols(), [](T x) { return (A)x; });
+        return s;
+    }, [](A x, A y) { return x + y; });
+}
+
+// Frobenius范数
+template <typename T>
+auto matNormFro(MatView<const T> a, int threads = 1) -> decltype(std::sqrt(MatAccum<T>())) {
+    using A = MatAccum<T>;
+    return std::sqrt(matReduceRows<A>(a, threads, [&](int i0, int i1) {
+        A s = 0;
+        for (int i = i0; i < i1; ++i) s += matLaneSum<A>(a[i], a.cols(), [](T x) { return (A)x * (A)x; });
+        return s;
+    }, [](A x, A y) { return x + y; }));
+}
+
+// 无穷范数: 各行绝对值之和的最大值
+template <typename T>
+MatAccum<T> matNormInf(MatView<const T> a, int threads = 1) {
+    using A = MatAccum<T>;
+    return matReduceRows<A>(a, threads, [&](int i0, int i1) {
+        A m = 0;
+        for (int i = i0; i < i1; ++i) m = std::max(m, matLaneSum<A>(a[i], a.cols(), [](T x) { return matAbs(x); }));
+        return m;
+    }, [](A x, A y) { return std::max(x, y); });
+}
+
+// 各列f(x)之和: 逐行把整行累加到列和上，内层沿行连续访问
+template <typename T, typename F>
+std::vector<MatAccum<T>> matColAccum(MatView<const T> a, int threads, F f) {
+    using A = MatAccum<T>;
+    using V = std::vector<A>;
+    V res = matReduceRows<V>(a, threads, [&](int i0, int i1) {
+        V s(a.cols(), 0);
+        for (int i = i0; i < i1; ++i) {
+            const T* x = a[i];
+            for (int j = 0; j < a.cols(); ++j) s[j] += f(x[j]);
+        }
+        return s;
+    }, [](V x, const V& y) {
+        for (size_t j = 0; j < x.size(); ++j) x[j] += y[j];
+        return x;
+    });
+    res.resize(a.cols(), 0);
+    return res;
+}
+
+// 1范数: 各列绝对值之和的最大值
+template <typename T>
+MatAccum<T> matNorm1(MatView<const T> a, int threads = 1) {
+    MatAccum<T> m = 0;
+    for (MatAccum<T> v : matColAccum(a, threads, [](T x) { return matAbs(x); })) m = std::max(m, v);
+    return m;
+}
+
+// 行和(r×1)
+template <typename T>
+MAT<MatAccum<T>> matRowSums(MatView<const T> a, int threads = 1) {
+    using A = MatAccum<T>;
+    MAT<A> res(a.rows(), 1);
+    matParallelChunks(a.rows(), std::max(1, MAT_REDUCE_CHUNK / std::max(1, a.cols())), threads, [&](int, int i0, int i1) {
+        for (int i = i0; i < i1; ++i) res[i][0] = matLaneSum<A>(a[i], a.cols(), [](T x) { return (A)x; });
+    });
+    return res;
+}
+
+// 列和(1×c)
+template <typename T>
+MAT<MatAccum<T>> matColSums(MatView<const T> a, int threads = 1) {
+    std::vector<MatAccum<T>> s = matColAccum(a, threads, [](T x) { return (MatAccum<T>)x; });
+    MAT<MatAccum<T>> res(1, a.cols());
+    std::copy(s.begin(), s.end(), res[0]);
+    return res;
+}
+
+// 最小、最大元素
+template <bool greater, typename T>
+T matExtreme(MatView<const T> a, int threads) {
+    if (a.rows() == 0 || a.cols() == 0) throw std::invalid_argument("空矩阵无最值");
+    return matReduceRows<T>(a, threads, [&](int i0, int i1) {
+        T m = matLaneExtreme<greater>(a[i0], a.cols());
+        for (int i = i0 + 1; i < i1; ++i) {
+            const T v = matLaneExtreme<greater>(a[i], a.cols());
+            if (greater ? v > m : v < m) m = v;
+        }
+        return m;
+    }, [](T x, T y) { return (greater ? y > x : y < x) ? y : x; });
+}
+template <typename T>
+T matMin(MatView<const T> a, int threads = 1) {
+    return matExtreme<false>(a, threads);
+}
+template <typename T>
+T matMax(MatView<const T> a, int threads = 1) {
+    return matExtreme<true>(a, threads);
+}
+
+// 最大元素的位置(行, 列)，有多个时取按行优先的第一个
+template <typename T>
+std::pair<int, int> matArgMax(MatView<const T> a, int threads = 1) {
+    if (a.rows() == 0 || a.cols() == 0) throw std::invalid_argument("空矩阵无最值");
+    struct Best { T v; int i, j; };
+    Best b = matReduceRows<Best>(a, threads, [&](int i0, int i1) {
+        Best m{ T(), -1, -1 };
+        for (int i = i0; i < i1; ++i) {
+            const T v = matLaneExtreme<true>(a[i], a.cols());
+            if (m.i >= 0 && !(v > m.v)) continue;
+            const T* x = a[i];
+            m = { v, i, (int)(std::find(x, x + a.cols(), v) - x) };
+        }
+        return m;
+    }, [](Best x, const Best& y) { return y.v > x.v ? y : x; });
+    return { b.i, b.j };
+}
+
+// 逐元素变换: 返回f(a[i][j])组成的矩阵，f经模板内联
+template <typename T, typename F>
+auto matMap(MatView<const T> a, F f, int threads = 1) -> MAT<typename std::decay<decltype(f(std::declval<T>()))>::type> {
+    MAT<typename std::decay<decltype(f(std::declval<T>()))>::type> res(a.rows(), a.cols());
+    matParallelChunks(a.rows(), std::max(1, MAT_REDUCE_CHUNK / std::max(1, a.cols())), threads, [&](int, int i0, int i1) {
+        for (int i = i0; i < i1; ++i) {
+            const T* x = a[i];
+            auto* y = res[i];
+            for (int j = 0; j < a.cols(); ++j) y[j] = f(x[j]);
+        }
+    });
+    return res;
+}
+
+// 逐元素二元变换: 返回f(a[i][j], b[i][j])组成的矩阵
+template <typename T, typename U, typename F>
+auto matZip(MatView<const T> a, MatView<const U> b, F f, int threads = 1)
+    -> MAT<typename std::decay<decltype(f(std::declval<T>(), std::declval<U>()))>::type> {
+    if (a.rows() != b.rows() || a.cols() != b.cols()) throw std::invalid_argument("逐元素运算维度不符");
+    MAT<typename std::decay<decltype(f(std::declval<T>(), std::declval<U>()))>::type> res(a.rows(), a.cols());
+    matParallelChunks(a.rows(), std::max(1, MAT_REDUCE_CHUNK / std::max(1, a.cols())), threads, [&](int, int i0, int i1) {
+        for (int i = i0; i < i1; ++i) {
+            const T* x = a[i];
+            const U* y = b[i];
+            auto* z = res[i];
+            for (int j = 0; j < a.cols(); ++j) z[j] = f(x[j], y[j]);
+        }
+    });
+    return res;
+}
+
+// 元素类型: 供MAT、可写视图与映射矩阵直接调用下列函数；它们到MatView<const T>的转换不参与模板推导
+template <typename M> struct MatElemOf {};
+template <typename T> struct MatElemOf<MAT<T>> { using type = T; };
+template <typename T> struct MatElemOf<MatView<T>> : std::enable_if<!std::is_const<T>::value, T> {};
+template <typename T> struct MatElemOf<MappedMAT<T>> { using type = T; };
+
+template <typename M, typename T = typename MatElemOf<M>::type>
+MatAccum<T> matSum(const M& a, int threads = 1) { return matSum(MatView<const T>(a), threads); }
+template <typename M, typename T = typename MatElemOf<M>::type>
+auto matNormFro(const M& a, int threads = 1) -> decltype(std::sqrt(MatAccum<T>())) { return matNormFro(MatView<const T>(a), threads); }
+template <typename M, typename T = typename MatElemOf<M>::type>
+MatAccum<T> matNormInf(const M& a, int threads = 1) { return matNormInf(MatView<const T>(a), threads); }
+template <typename M, typename T = typename MatElemOf<M>::type>
+MatAccum<T> matNorm1(const M& a, int threads = 1) { return matNorm1(MatView<const T>(a), threads); }
+template <typename M, typename T = typename MatElemOf<M>::type>
+MAT<MatAccum<T>> matRowSums(const M& a, int threads = 1) { return matRowSums(MatView<const T>(a), threads); }
+template <typename M, typename T = typename MatElemOf<M>::type>
+MAT<MatAccum<T>> matColSums(const M& a, int threads = 1) { return matColSums(MatView<const T>(a), threads); }
+template <typename M, typename T = typename MatElemOf<M>::type>
+T matMin(const M& a, int threads = 1) { return matMin(MatView<const T>(a), threads); }
+template <typename M, typename T = typename MatElemOf<M>::type>
+T matMax(const M& a, int threads = 1) { return matMax(MatView<const T>(a), threads); }
+template <typename M, typename T = typename MatElemOf<M>::type>
+std::pair<int, int> matArgMax(const M& a, int threads = 1) { return matArgMax(MatView<const T>(a), threads); }
+template <typename M, typename F, typename T = typename MatElemOf<M>::type>
+auto matMap(const M& a, F f, int threads = 1) -> decltype(matMap(MatView<const T>(a), f, threads)) {
+    return matMap(MatView<const T>(a), f, threads);
+}
+template <typename M, typename N, typename F, typename T = typename MatElemOf<M>::type, typename U = typename MatElemOf<N>::type>
+auto matZip(const M& a, const N& b, F f, int threads = 1) -> decltype(matZip(MatView<const T>(a), MatView<const U>(b), f, threads)) {
+    return matZip(MatView<const T>(a), MatView<const U>(b), f, threads);
+}
+
+// 归约测试: 与逐元素循环对比，并检查不同线程数下浮点求和逐位一致
+void testMatReduce() {
+    MAT<int> a(37, 45);
+    for (int i = 0; i < 37; ++i) for (int j = 0; j < 45; ++j) a[i][j] = (i * 17 + j * 29) % 101 - 50;
+    a[20][33] = 500;
+    long long sum = 0, sq = 0, ninf = 0, n1 = 0;
+    int mn = a[0][0], mx = a[0][0];
+    for (int i = 0; i < 37; ++i) {
+        long long rs = 0;
+        for (int j = 0; j < 45; ++j) {
+            sum += a[i][j]; sq += a[i][j] * a[i][j]; rs += std::abs(a[i][j]);
+            mn = std::min(mn, a[i][j]); mx = std::max(mx, a[i][j]);
+        }
+        ninf = std::max(ninf, rs);
+    }
+    for (int j = 0; j < 45; ++j) {
+        long long cs = 0;
+        for (int i = 0; i < 37; ++i) cs += std::abs(a[i][j]);
+        n1 = std::max(n1, cs);
+    }
+    MAT<long long> rows = matRowSums(a), cols = matColSums(a, 3);
+    long long rsum = 0, csum = 0;
+    for (int i = 0; i < 37; ++i) rsum += rows[i][0];
+    for (int j = 0; j < 45; ++j) csum += cols[0][j];
+    bool ok = matSum(a) == sum && matSum(a, 4) == sum && matNormFro(a) == std::sqrt((double)sq)
+        && matNormInf(a, 2) == ninf && matNorm1(a) == n1 && matMin(a) == mn && matMax(a, 5) == mx
+        && matArgMax(a, 3) == std::make_pair(20, 33) && rsum == sum && csum == sum
+        && matSum(a.view()) == sum && matSum(a.block(0, 0, 37, 45), 3) == sum && matSum<int>(a) == sum;
+
+    MAT<double> d(3000, 7);
+    for (int i = 0; i < 3000; ++i) for (int j = 0; j < 7; ++j) d[i][j] = std::sin(i * 7.0 + j) * 1e3;
+    const double s1 = matSum(d);
+    for (int t = 2; t <= 8; ++t) ok = ok && matSum(d, t) == s1;
+    MAT<double> half = matMap(d, [](double x) { return x * 0.5; }, 3);
+    MAT<double> diff = matZip(d, half, [](double x, double y) { return x - 2 * y; });
+    ok = ok && matMax(diff) == 0 && matMin(diff) == 0;
+    MAT<int> pos = matMap(a.block(0, 1, 2, 2), [](int x) { return x > 0 ? 1 : 0; });
+    cout << (ok ? "归约与逐元素变换正确" : "归约与逐元素变换错误") << " 正元素: " << pos[0][0] << pos[0][1] << pos[1][0] << pos[1][1] << endl;
+}
+
+// 归约基准: 按operator[]逐元素循环与分块多路归约(1/4线程)，及特征归一化(减均值除以范数)
+void benchMatReduce(int n) {
+    MAT<double> a(n, n);
+    for (int i = 0; i < n; ++i) for (int j = 0; j < n; ++j) a[i][j] = ((i * 31 + j * 17) % 1000) / 999.0 - 0.3;
+    auto ms = [](std::chrono::steady_clock::time_point t0, std::chrono::steady_clock::time_point t1) {
+        return std::chrono::duration<double, std::milli>(t1 - t0).count();
+    };
+    const MAT<double>& ca = a;
+    auto t0 = std::chrono::steady_clock::now();
+    double s0 = 0, m0 = ca[0][0];
+    for (int i = 0; i < n; ++i) for (int j = 0; j < n; ++j) { s0 += ca[i][j]; m0 = std::max(m0, ca[i][j]); }
+    auto t1 = std::chrono::steady_clock::now();
+    double s1 = matSum(a), m1 = matMax(a);
+    auto t2 = std::chrono::steady_clock::now();
+    double s4 = matSum(a, 4), m4 = matMax(a, 4);
+    auto t3 = std::chrono::steady_clock::now();
+    cout << "归约 " << n << "x" << n << " 求和+最大值  逐元素 " << ms(t0, t1) << " ms  多路 " << ms(t1, t2) << " ms  4线程 "
+         << ms(t2, t3) << " ms  " << (s1 == s4 && m1 == m4 && m0 == m1 ? "结果一致" : "结果不一致") << " 相对差 "
+         << std::fabs(s0 - s1) / std::fabs(s1) << endl;
+
+    t0 = std::chrono::steady_clock::now();
+    const double mean = matSum(a) / ((double)n * n);
+    const double norm = matNormFro(a);
+    MAT<double> z = matMap(a, [=](double x) { return (x - mean) / norm; });
+    t1 = std::chrono::steady_clock::now();
+    cout << "特征归一化 " << n << "x" << n << "  " << ms(t0, t1) << " ms  均值 " << matSum(z) << endl;
+}
+
+// 浮点矩阵乘法的累加方式
+enum class MatAcc {
+    Native,   // 按元素类型累加，与operator*相同
+    Wide,     // 元素类型存储，以double累加
+    Kahan,    // Kahan补偿求和
+    Pairwise  // 两两求和: 误差随长度对数增长
+};
+
+// Kahan补偿点积: 8路各自补偿，最后按补偿加法合并
+template <typename T>
+T matDotKahan(const T* x, const T* y, int n) {
+    T s[MAT_LANES] = {}, c[MAT_LANES] = {};
+    auto add = [&](int l, T v) {
+        const T u = v - c[l];
+        const T t = s[l] + u;
+        c[l] = (t - s[l]) - u;
+        s[l] = t;
+    };
+    int p = 0;
+    for (; p + MAT_LANES <= n; p += MAT_LANES)
+        for (int l = 0; l < MAT_LANES; ++l) add(l, x[p + l] * y[p + l]);
+    for (int l = 0; p < n; ++p, ++l) add(l, x[p] * y[p]);
+    for (int l = 1; l < MAT_LANES; ++l) {
+        add(0, s[l]);
+        add(0, -c[l]);
+    }
+    return s[0];
+}
+
+// 两两求和点积: 对半递归，不超过128项时多路直接累加
+template <typename T>
+T matDotPairwise(const T* x, const T* y, int n) {
+    if (n <= 128) {
+        T acc[MAT_LANES] = {};
+        int p = 0;
+        for (; p + MAT_LANES <= n; p += MAT_LANES)
+            for (int l = 0; l < MAT_LANES; ++l) acc[l] += x[p + l] * y[p + l];
+        for (int l = 0; p < n; ++p, ++l) acc[l] += x[p] * y[p];
+        for (int w = MAT_LANES / 2; w > 0; w /= 2)
+            for (int l = 0; l < w; ++l) acc[l] += acc[l + w];
+        return acc[0];
+    }
+    const int h = (n / 2 + MAT_LANES - 1) / MAT_LANES * MAT_LANES;
+    return matDotPairwise(x, y, h) + matDotPairwise(x + h, y + h, n - h);
+}
+
+// 指定累加方式的乘法: 存储仍为T
+// Wide按i-k-j顺序累加到一行double缓冲区；Kahan/Pairwise先把b转置一次，使每个结果元素是两段连续数据的点积
+template <typename T>
+MAT<T> matMulAcc(MatView<const T> a, MatView<const T> b, MatAcc mode) {
+    static_assert(std::is_floating_point<T>::value, "累加方式仅适用于浮点矩阵");
+    if (a.cols() != b.rows()) throw std::invalid_argument("矩阵乘法维度不符");
+    const int m = a.rows(), k = a.cols(), n = b.cols();
+    MAT<T> res(m, n);
+    if (mode == MatAcc::Native) {
+        matKernel(a.data(), a.stride(), b.data(), b.stride(), res.data(), res.stride(), m, k, n);
+    }
+    else if (mode == MatAcc::Wide) {
+        std::vector<double> acc(n);
+        for (int i = 0; i < m; ++i) {
+            std::fill(acc.begin(), acc.end(), 0.0);
+            const T* ai = a[i];
+            for (int p = 0; p < k; ++p) {
+                const double aip = ai[p];
+                const T* bp = b[p];
+                for (int j = 0; j < n; ++j) acc[j] += aip * bp[j];
+            }
+            T* ci = res[i];
+            for (int j = 0; j < n; ++j) ci[j] = (T)acc[j];
+        }
+    }
+    else {
+        MAT<T> bt = ~b;
+        for (int i = 0; i < m; ++i)
+            for (int j = 0; j < n; ++j)
+                res[i][j] = mode == MatAcc::Kahan ? matDotKahan(a[i], bt[j], k) : matDotPairwise(a[i], bt[j], k);
+    }
+    return res;
+}
+template <typename T>
+MAT<T> matMulAcc(const MAT<T>& a, const MAT<T>& b, MatAcc mode) {
+    return matMulAcc(a.view(), b.view(), mode);
+}
+
+// bfloat16: float的高16位(8位指数、7位尾数)，数值范围同float而内存减半
+// 由float转换时舍入到最近偶数；参与运算时先转为float
+struct bf16 {
+    uint16_t bits = 0;
+
+    bf16() = default;
+    bf16(float f) {
+        uint32_t u;
+        memcpy(&u, &f, sizeof(u));
+        if ((u & 0x7fffffffu) > 0x7f800000u) bits = uint16_t((u >> 16) | 0x40); // NaN保持为静默NaN
+        else bits = uint16_t((u + 0x7fffu + ((u >> 16) & 1)) >> 16);
+    }
+    operator float() const {
+        const uint32_t u = (uint32_t)bits << 16;
+        float f;
+        memcpy(&f, &u, sizeof(f));
+        return f;
+    }
+    bf16& operator+=(float x) { return *this = float(*this) + x; }
+    bf16& operator-=(float x) { return *this = float(*this) - x; }
+    bf16& operator*=(float x) { return *this = float(*this) * x; }
+};
+
+// bf16存储的乘法: 以float累加，结果为float矩阵
+inline MAT<float> matMulBf16(MatView<const bf16> a, MatView<const bf16> b) {
+    if (a.cols() != b.rows()) throw std::invalid_argument("矩阵乘法维度不符");
+    const int m = a.rows(), k = a.cols(), n = b.cols();
+    MAT<float> res(m, n);
+    for (int i = 0; i < m; ++i) {
+        float* ci = res[i];
+        const bf16* ai = a[i];
+        for (int p = 0; p < k; ++p) {
+            const float aip = ai[p];
+            const bf16* bp = b[p];
+            for (int j = 0; j < n; ++j) ci[j] += aip * float(bp[j]);
+        }
+    }
+    return res;
+}
+
+// 累加方式测试: 长点积上各方式与精确值的误差，及bf16的舍入
+void testMatAcc() {
+    const int k = 100000;
+    MAT<float> a(1, k), b(k, 2);
+    double exact0 = 0, exact1 = 0;
+    for (int p = 0; p < k; ++p) {
+        a[0][p] = 0.1f;
+        b[p][0] = 1;
+        b[p][1] = (p % 3) * 0.7f;
+        exact0 += (double)a[0][p];
+        exact1 += (double)a[0][p] * (double)b[p][1];
+    }
+    double err[4];
+    const MatAcc modes[] = { MatAcc::Native, MatAcc::Wide, MatAcc::Kahan, MatAcc::Pairwise };
+    for (int t = 0; t < 4; ++t) {
+        MAT<float> c = matMulAcc(a, b, modes[t]);
+        err[t] = std::max(std::fabs(c[0][0] - exact0) / exact0, std::fabs(c[0][1] - exact1) / exact1);
+    }
+    bool ok = err[1] < 1e-6 && err[2] < 1e-6 && err[3] < 1e-6 && err[0] > 10 * err[3];
+    ok = ok && float(bf16(1.0f)) == 1.0f && float(bf16(1.00390625f)) == 1.0f && float(bf16(1.01171875f)) == 1.015625f;
+    MAT<bf16> h(2, 2);
+    h[0][0] = 1.5f; h[0][1] = -2; h[1][0] = 0.25f; h[1][1] = 3;
+    MAT<float> hh = matMulBf16(h, h);
+    ok = ok && hh[0][0] == 1.75f && hh[1][1] == 8.5f;
+    cout << (ok ? "累加方式正确" : "累加方式错误") << " float累加相对误差 " << err[0] << endl;
+}
+
+// 累加方式基准: m×k乘k×n，k较长；报告各方式的GFLOP/s和相对double参考结果的最大误差
+void benchMatAcc(int m, int k, int n) {
+    MAT<float> a(m, k), b(k, n);
+    for (int i = 0; i < m; ++i) for (int p = 0; p < k; ++p) a[i][p] = ((i * 31 + p * 17) % 1000) / 1000.0f;
+    for (int p = 0; p < k; ++p) for (int j = 0; j < n; ++j) b[p][j] = ((p * 13 + j * 7) % 997) / 997.0f;
+    MAT<double> da = matMap(a, [](float x) { return (double)x; });
+    MAT<double> db = matMap(b, [](float x) { return (double)x; });
+    MAT<double> ref = matMulAcc(da, db, MatAcc::Kahan);
+    auto report = [&](const char* name, MatView<const float> c, double sec) {
+        double err = 0;
+        for (int i = 0; i < m; ++i) for (int j = 0; j < n; ++j) err = std::max(err, std::fabs(c[i][j] - ref[i][j]) / std::fabs(ref[i][j]));
+        cout << "  " << name << "  " << std::setprecision(3) << 2.0 * m * n * k / sec * 1e-9
+             << " GFLOP/s  最大相对误差 " << err << endl;
+    };
+    cout << "累加方式 " << m << "x" << k << " * " << k << "x" << n << endl;
+    const char* names[] = { "float", "double累加", "Kahan", "两两求和" };
+    const MatAcc modes[] = { MatAcc::Native, MatAcc::Wide, MatAcc::Kahan, MatAcc::Pairwise };
+    for (int t = 0; t < 4; ++t) {
+        auto t0 = std::chrono::steady_clock::now();
+        MAT<float> c = matMulAcc(a, b, modes[t]);
+        auto t1 = std::chrono::steady_clock::now();
+        report(names[t], c, std::chrono::duration<double>(t1 - t0).count());
+    }
+    MAT<bf16> ha = matMap(a, [](float x) { return bf16(x); });
+    MAT<bf16> hb = matMap(b, [](float x) { return bf16(x); });
+    auto t0 = std::chrono::steady_clock::now();
+    MAT<float> c = matMulBf16(ha, hb);
+    auto t1 = std::chrono::steady_clock::now();
+    report("bf16", c, std::chrono::duration<double>(t1 - t0).count());
+    cout << std::setprecision(6);
+}
+
+// LU分解结果: P·A = L·U，单位下三角L(不存对角)与U合存于lu；第k步交换了第k行与第piv[k]行
+template <typename T>
+struct MatLU {
+    MAT<T> lu;
+    std::vector<int> piv;
+    int sign = 1;          // 置换的符号，求行列式用
+    bool singular = false; // 某步主元为0
+
+    explicit MatLU(int n) : lu(n, n), piv(n) {}
+    int order() const { return lu.rows(); }
+};
+
+// 分块右视LU分解(部分主元)
+// 每次分解nb列的面板，解出U的对应行块，再以乘法核对右下剩余块做秩nb更新；该更新占绝大部分运算，按行分给各线程
+template <typename T>
+MatLU<T> luDecompose(MatView<const T> a, int threads = 1, int nb = 64) {
+    static_assert(std::is_floating_point<T>::value, "LU分解仅适用于浮点矩阵");
+    if (a.rows() != a.cols()) throw std::invalid_argument("LU分解须为方阵");
+    const int n = a.rows();
+    MatLU<T> f(n);
+    f.lu.view().assign(a);
+    T* A = f.lu.data();
+    const size_t ld = f.lu.stride();
+    nb = std::max(1, nb);
+    for (int k0 = 0; k0 < n; k0 += nb) {
+        const int kb = std::min(nb, n - k0), k1 = k0 + kb;
+        // 面板分解: 逐列选主元、整行交换、消去面板内其余列
+        for (int j = k0; j < k1; ++j) {
+            int p = j;
+            for (int i = j + 1; i < n; ++i)
+                if (std::fabs(A[i * ld + j]) > std::fabs(A[p * ld + j])) p = i;
+            f.piv[j] = p;
+            if (p != j) {
+                std::swap_ranges(A + j * ld, A + j * ld + n, A + p * ld);
+                f.sign = -f.sign;
+            }
+            const T d = A[j * ld + j];
+            if (d == T(0)) { f.singular = true; continue; }
+            for (int i = j + 1; i < n; ++i) {
+                T* ai = A + i * ld;
+                const T l = ai[j] /= d;
+                const T* aj = A + j * ld;
+                for (int c = j + 1; c < k1; ++c) ai[c] -= l * aj[c];
+            }
+        }
+        if (k1 == n) break;
+        // U12 = L11⁻¹·A12: 单位下三角前代，逐行做整行的倍加
+        for (int i = k0 + 1; i < k1; ++i) {
+            T* ai = A + i * ld;
+            for (int q = k0; q < i; ++q) {
+                const T l = ai[q];
+                const T* aq = A + q * ld;
+                for (int c = k1; c < n; ++c) ai[c] -= l * aq[c];
+            }
+        }
+        // A22 -= L21·U12: 按列分段使U12的一段留在缓存中，行区间分给各线程
+        const int m2 = n - k1;
+        const int COLS = 512;
+        auto update = [&](int i0, int i1) {
+            for (int c0 = k1; c0 < n; c0 += COLS)
+                matKernel(A + i0 * ld + k0, (int)ld, A + k0 * ld + c0, (int)ld, A + i0 * ld + c0, (int)ld,
+                          i1 - i0, kb, std::min(COLS, n - c0), T(-1), T(1));
+        };
+        const int tn = std::max(1, std::min(threads, m2 / 64));
+        std::vector<std::thread> pool;
+        for (int t = 1; t < tn; ++t)
+            pool.emplace_back(update, k1 + (int)((long long)m2 * t / tn), k1 + (int)((long long)m2 * (t + 1) / tn));
+        update(k1, k1 + m2 / tn);
+        for (auto& th : pool) th.join();
+    }
+    return f;
+}
+template <typename T>
+MatLU<T> luDecompose(const MAT<T>& a, int threads = 1, int nb = 64) {
+    return luDecompose(a.view(), threads, nb);
+}
+
+// 由LU分解解A·X = B，B可有多列: 按piv置换B的行，再前代、回代；每步是整行倍加，沿B的行连续
+template <typename T>
+MAT<T> luSolve(const MatLU<T>& f, MatView<const T> b) {
+    const int n = f.order();
+    if (b.rows() != n) throw std::invalid_argument("方程组维度不符");
+    if (f.singular) throw std::runtime_error("矩阵奇异，无法求解");
+    MAT<T> x(b);
+    const int m = b.cols();
+    for (int k = 0; k < n; ++k)
+        if (f.piv[k] != k) std::swap_ranges(x[k], x[k] + m, x[f.piv[k]]);
+    for (int i = 1; i < n; ++i) {
+        const T* li = f.lu[i];
+        T* xi = x[i];
+        for (int q = 0; q < i; ++q) {
+            const T l = li[q];
+            const T* xq = x[q];
+            for (int c = 0; c < m; ++c) xi[c] -= l * xq[c];
+        }
+    }
+    for (int i = n - 1; i >= 0; --i) {
+        const T* ui = f.lu[i];
+        T* xi = x[i];
+        for (int q = i + 1; q < n; ++q) {
+            const T u = ui[q];
+            const T* xq = x[q];
+            for (int c = 0; c < m; ++c) xi[c] -= u * xq[c];
+        }
+        const T d = ui[i];
+        for (int c = 0; c < m; ++c) xi[c] /= d;
+    }
+    return x;
+}
+
+template <typename T>
+MAT<T> solve(MatView<const T> a, MatView<const T> b, int threads = 1) {
+    return luSolve(luDecompose(a, threads), b);
+}
+template <typename T>
+MAT<T> solve(const MAT<T>& a, const MAT<T>& b, int threads = 1) {
+    return solve(a.view(), b.view(), threads);
+}
+
+// 行列式: U的对角元之积乘置换符号，奇异时为0
+template <typename T>
+T det(const MatLU<T>& f) {
+    if (f.singular) return 0;
+    T d = T(f.sign);
+    for (int i = 0; i < f.order(); ++i) d *= f.lu[i][i];
+    return d;
+}
+template <typename T>
+T det(const MAT<T>& a, int threads = 1) {
+    return det(luDecompose(a, threads));
+}
+
+// 逆矩阵: 解A·X = I
+template <typename T>
+MAT<T> inverse(const MAT<T>& a, int threads = 1) {
+    MAT<T> id(a.rows(), a.cols());
+    for (int i = 0; i < a.rows(); ++i) id[i][i] = 1;
+    return solve(a, id, threads);
+}
+
+// LU测试: 跨越多个分块的矩阵求解、行列式、逆矩阵，及奇异矩阵
+void testLU() {
+    const int n = 150;
+    MAT<double> a(n, n), b(n, 2);
+    for (int i = 0; i < n; ++i) {
+        for (int j = 0; j < n; ++j) a[i][j] = std::sin(i * 1.3 + j * 0.7) + (i == (j * 7) % n ? 2.0 : 0.0);
+        b[i][0] = i;
+        b[i][1] = 1;
+    }
+    MAT<double> x = solve(a, b, 3);
+    MAT<double> r = a * x;
+    double res = 0;
+    for (int i = 0; i < n; ++i) for (int j = 0; j < 2; ++j) res = std::max(res, std::fabs(r[i][j] - b[i][j]));
+    MatLU<double> f1 = luDecompose(a, 1, 16), f4 = luDecompose(a, 4, 16);
+    bool ok = res < 1e-9 && det(f1) == det(f4);
+
+    MAT<double> s(3, 3);
+    s[0][0] = 2; s[0][1] = 1; s[0][2] = 1;
+    s[1][0] = 4; s[1][1] = -6; s[1][2] = 0;
+    s[2][0] = -2; s[2][1] = 7; s[2][2] = 2;
+    MAT<double> inv = inverse(s), e = s * inv;
+    for (int i = 0; i < 3; ++i) for (int j = 0; j < 3; ++j) ok = ok && std::fabs(e[i][j] - (i == j)) < 1e-12;
+    cout << (ok ? "LU求解正确" : "LU求解错误") << " 残差 " << res << "  det = " << det(s) << endl;
+    s[0][0] = 1; s[0][1] = 2; s[0][2] = 3;
+    s[1][0] = 4; s[1][1] = 5; s[1][2] = 6;
+    s[2][0] = 2; s[2][1] = 4; s[2][2] = 6; // 第三行 = 第一行 × 2
+    cout << "奇异矩阵 det = " << det(s) << endl;
+    try {
+        inverse(s);
+    }
+    catch (const std::exception& ex) {
+        std::cout << "异常: " << ex.what() << std::endl;
+    }
+}
+
+// LU基准: 逐元素消元与分块分解(单线程/全部线程)的GFLOP/s(按2n³/3计)
+void benchLU(int maxN) {
+    const int hw = std::max(1, (int)std::thread::hardware_concurrency());
+    for (int n = 256; n <= maxN; n *= 2) {
+        MAT<double> a(n, n);
+        for (int i = 0; i < n; ++i) for (int j = 0; j < n; ++j) a[i][j] = ((i * 131 + j * 71) % 1009) / 1009.0 + (i == j ? n / 8 : 0);
+        const double flops = 2.0 * n * n * (double)n / 3;
+        auto gf = [&](std::chrono::steady_clock::time_point t0, std::chrono::steady_clock::time_point t1) {
+            return flops / std::chrono::duration<double>(t1 - t0).count() * 1e-9;
+        };
+        cout << "LU n=" << n << std::setprecision(3);
+        if (n <= 1024) {
+            MAT<double> u(a);
+            auto t0 = std::chrono::steady_clock::now();
+            for (int k = 0; k < n; ++k) {
+                int p = k;
+                for (int i = k + 1; i < n; ++i) if (std::fabs(u[i][k]) > std::fabs(u[p][k])) p = i;
+                for (int j = 0; j < n; ++j) std::swap(u[k][j], u[p][j]);
+                for (int i = k + 1; i < n; ++i) {
+                    const double l = u[i][k] /= u[k][k];
+                    for (int j = k + 1; j < n; ++j) u[i][j] -= l * u[k][j];
+                }
+            }
+            auto t1 = std::chrono::steady_clock::now();
+            cout << "  逐元素 " << gf(t0, t1) << " GFLOP/s";
+        }
+        auto t0 = std::chrono::steady_clock::now();
+        MatLU<double> f = luDecompose(a, 1);
+        auto t1 = std::chrono::steady_clock::now();
+        cout << "  分块 " << gf(t0, t1) << " GFLOP/s";
+        if (hw > 1) {
+            t0 = std::chrono::steady_clock::now();
+            MatLU<double> g = luDecompose(a, hw);
+            t1 = std::chrono::steady_clock::now();
+            cout << "  " << hw << "线程 " << gf(t0, t1) << " GFLOP/s";
+        }
+        cout << std::setprecision(6) << endl;
+    }
+}
+
+// 分块文件矩阵的I/O统计
+struct TileIOStats {
+    unsigned long long bytesRead = 0, bytesWritten = 0;
+    unsigned long long hits = 0;       // 命中缓存的取块次数
+    unsigned long long misses = 0;     // 未命中，需从文件读入(或新建)
+    unsigned long long prefetched = 0; // 未命中但已由预取读好
+};
+
+// 分块文件矩阵: 元素按ts×ts的块存于文件，块内行优先、块按行优先排列，边缘块补零到整块
+// 内存中只保留不超过cacheTiles个块(LRU换出，脏块写回)，并可在后台预取下一块；矩阵大小不受内存限制
+// 文件只作后备存储，不带文件头；未写过的块读出为零
+template <typename T>
+class TiledMAT {
+    struct Slot {
+        long long tile = -1;
+        bool dirty = false;
+        unsigned long long used = 0;
+        std::unique_ptr<T[]> data;
+    };
+    std::unique_ptr<FILE, int (*)(FILE*)> f;
+    int r, c, ts, tr, tc; // 行列数、块边长、块行数、块列数
+    mutable std::vector<Slot> cache;
+    mutable unsigned long long tick = 0;
+    mutable std::unique_ptr<std::mutex> io; // 预取线程与本线程共用同一文件
+    mutable std::future<void> pending;      // 进行中的预取
+    mutable long long pendingTile = -1;
+    mutable std::unique_ptr<T[]> pendingBuf;
+    mutable TileIOStats st;
+
+    size_t tileElems() const { return (size_t)ts * ts; }
+    uint64_t tileOffset(long long id) const { return (uint64_t)id * tileElems() * sizeof(T); }
+
+    // 读一块，文件末尾之后的部分为零；可在预取线程中调用
+    static void readTile(FILE* fp, std::mutex& m, uint64_t off, T* buf, size_t n) {
+        std::lock_guard<std::mutex> lock(m);
+        size_t got = 0;
+        if (matFileSeek(fp, off) == 0) got = fread(buf, sizeof(T), n, fp);
+        if (got < n && ferror(fp)) throw std::runtime_error("读取矩阵块失败");
+        std::fill(buf + got, buf + n, T(0));
+    }
+    void writeTile(long long id, const T* buf) const {
+        std::lock_guard<std::mutex> lock(*io);
+        if (matFileSeek(f.get(), tileOffset(id)) != 0 || fwrite(buf, sizeof(T), tileElems(), f.get()) != tileElems())
+            throw std::runtime_error("写入矩阵块失败");
+        st.bytesWritten += tileElems() * sizeof(T);
+    }
+    // 等待并丢弃未被取用的预取
+    void dropPending() const {
+        if (pending.valid()) pending.get();
+        pendingTile = -1;
+    }
+
+    // 取第id块的缓存槽；load为false时不读文件，由调用方写满整块
+    Slot& slot(long long id, bool load) const {
+        Slot* victim = &cache[0];
+        for (Slot& s : cache) {
+            if (s.tile == id) {
+                ++st.hits;
+                s.used = ++tick;
+                return s;
+            }
+            if (s.used < victim->used) victim = &s;
+        }
+        ++st.misses;
+        if (victim->tile >= 0 && victim->dirty) writeTile(victim->tile, victim->data.get());
+        if (!victim->data) victim->data.reset(new T[tileElems()]);
+        if (pendingTile == id) {
+            pending.get();
+            pendingTile = -1;
+            std::swap(victim->data, pendingBuf);
+            ++st.prefetched;
+        }
+        else if (load) {
+            readTile(f.get(), *io, tileOffset(id), victim->data.get(), tileElems());
+            st.bytesRead += tileElems() * sizeof(T);
+        }
+        victim->tile = id;
+        victim->dirty = false;
+        victim->used = ++tick;
+        return *victim;
+    }
+
+    // 整块改写块(ti,tj): 不读原内容，由调用方写满
+    T* tileFresh(int ti, int tj) const {
+        Slot& s = slot((long long)ti * tc + tj, false);
+        s.dirty = true;
+        return s.data.get();
+    }
+
+    // 先检查维度与块边长，再打开块文件
+    static FILE* openTiles(int r_, int c_, int ts_, const char* path) {
+        if (r_ < 0 || c_ < 0 || ts_ <= 0) throw std::invalid_argument("分块矩阵维度或块边长非法");
+        return path ? fopen(path, "w+b") : tmpfile();
+    }
+
+public:
+    // r×c矩阵，块边长ts，缓存cacheTiles块(至少2块)；path为空时使用自动删除的临时文件
+    TiledMAT(int r_, int c_, int ts_ = 256, int cacheTiles = 8, const char* path = nullptr)
+        : f(openTiles(r_, c_, ts_, path), fclose), r(r_), c(c_), ts(ts_),
+          tr(r_ / ts_ + (r_ % ts_ != 0)), tc(c_ / ts_ + (c_ % ts_ != 0)), cache(std::max(2, cacheTiles)), io(new std::mutex) {
+        if (!f) throw std::runtime_error("无法创建矩阵块文件");
+    }
+    // 由内存中的矩阵逐块写出
+    explicit TiledMAT(MatView<const T> a, int ts_ = 256, int cacheTiles = 8, const char* path = nullptr)
+        : TiledMAT(a.rows(), a.cols(), ts_, cacheTiles, path) {
+        for (int ti = 0; ti < tr; ++ti)
+            for (int tj = 0; tj < tc; ++tj) {
+                T* t = tileFresh(ti, tj);
+                std::fill(t, t + tileElems(), T(0));
+                const int h = std::min(ts, r - ti * ts), w = std::min(ts, c - tj * ts);
+                for (int i = 0; i < h; ++i) std::copy_n(a[ti * ts + i] + tj * ts, w, t + (size_t)i * ts);
+            }
+    }
+    TiledMAT(TiledMAT&&) = default;
+    TiledMAT& operator=(TiledMAT&&) = delete;
+    ~TiledMAT() noexcept {
+        if (!f) return;
+        try {
+            dropPending();
+            flush();
+        }
+        catch (...) {
+        }
+    }
+
+    // 取块(ti,tj)只读/读写；返回的指针在此后再取一块之前有效(至少缓存两块，交替取两块时两者都有效)
+    const T* tileRead(int ti, int tj) const {
+        return slot((long long)ti * tc + tj, true).data.get();
+    }
+    T* tileWrite(int ti, int tj) {
+        Slot& s = slot((long long)ti * tc + tj, true);
+        s.dirty = true;
+        return s.data.get();
+    }
+    // 在后台读入块(ti,tj)，随后取该块时不再等待I/O；已在缓存中或越界时忽略
+    void prefetch(int ti, int tj) const {
+        if (ti < 0 || ti >= tr || tj < 0 || tj >= tc) return;
+        const long long id = (long long)ti * tc + tj;
+        if (id == pendingTile) return;
+        for (const Slot& s : cache) if (s.tile == id) return;
+        dropPending();
+        if (!pendingBuf) pendingBuf.reset(new T[tileElems()]);
+        st.bytesRead += tileElems() * sizeof(T);
+        pendingTile = id;
+        pending = std::async(std::launch::async, readTile, f.get(), std::ref(*io), tileOffset(id), pendingBuf.get(), tileElems());
+    }
+    // 把脏块写回文件
+    void flush() const {
+        for (Slot& s : cache)
+            if (s.tile >= 0 && s.dirty) {
+                writeTile(s.tile, s.data.get());
+                s.dirty = false;
+            }
+        std::lock_guard<std::mutex> lock(*io);
+        fflush(f.get());
+    }
+
+    // 读入为内存矩阵
+    MAT<T> toMAT() const {
+        MAT<T> res(r, c);
+        for (int ti = 0; ti < tr; ++ti)
+            for (int tj = 0; tj < tc; ++tj) {
+                prefetch(ti + (tj + 1) / tc, (tj + 1) % tc);
+                const T* t = tileRead(ti, tj);
+                const int h = std::min(ts, r - ti * ts), w = std::min(ts, c - tj * ts);
+                for (int i = 0; i < h; ++i) std::copy_n(t + (size_t)i * ts, w, res[ti * ts + i] + tj * ts);
+            }
+        return res;
+    }
+
+    // 分块乘法: 结果块C(i,j)在缓存中就地累加A(i,p)·B(p,j)，同时预取下一对操作数块
+    TiledMAT operator*(const TiledMAT& b) const {
+        if (c != b.r) throw std::invalid_argument("矩阵乘法维度不符");
+        if (ts != b.ts) throw std::invalid_argument("分块大小不符");
+        TiledMAT res(r, b.c, ts, (int)cache.size());
+        for (int i = 0; i < tr; ++i)
+            for (int j = 0; j < b.tc; ++j) {
+                T* acc = res.tileFresh(i, j);
+                for (int p = 0; p < tc; ++p) {
+                    const T* x = tileRead(i, p);
+                    const T* y = b.tileRead(p, j);
+                    if (p + 1 < tc) { prefetch(i, p + 1); b.prefetch(p + 1, j); }
+                    else if (j + 1 < b.tc) { prefetch(i, 0); b.prefetch(0, j + 1); }
+                    else { prefetch(i + 1, 0); b.prefetch(0, 0); }
+                    matKernel(x, ts, y, ts, acc, ts, ts, ts, ts, T(1), T(p == 0 ? 0 : 1));
+                }
+            }
+        return res;
+    }
+
+    // 分块转置: 块(i,j)转置后写到结果的块(j,i)
+    TiledMAT operator~() const {
+        TiledMAT res(c, r, ts, (int)cache.size());
+        for (int i = 0; i < tr; ++i)
+            for (int j = 0; j < tc; ++j) {
+                prefetch(i + (j + 1) / tc, (j + 1) % tc);
+                const T* x = tileRead(i, j);
+                T* y = res.tileFresh(j, i);
+                for (int a = 0; a < ts; ++a)
+                    for (int b = 0; b < ts; ++b) y[(size_t)b * ts + a] = x[(size_t)a * ts + b];
+            }
+        return res;
+    }
+
+    const TileIOStats& stats() const { return st; }
+    void resetStats() { st = TileIOStats(); }
+    // 行数
+    int rows() const { return r; }
+    // 列数
+    int cols() const { return c; }
+    // 块边长
+    int tileSize() const { return ts; }
+};
+
+// 分块文件矩阵测试: 小块、小缓存下的乘法与转置与内存结果对比
+void testTiledMAT() {
+    MAT<double> a(150, 100), b(100, 70);
+    for (int i = 0; i < 150; ++i) for (int j = 0; j < 100; ++j) a[i][j] = (i * 7 + j * 3) % 11 - 5;
+    for (int i = 0; i < 100; ++i) for (int j = 0; j < 70; ++j) b[i][j] = (i * 5 + j) % 13 - 6;
+    try {
+        TiledMAT<double> ta(a, 32, 3), tb(b, 32, 3);
+        MAT<double> c = (ta * tb).toMAT(), ref = a * b;
+        MAT<double> at = (~ta).toMAT();
+        bool ok = c.rows() == 150 && c.cols() == 70 && at.rows() == 100 && at.cols() == 150;
+        for (int i = 0; i < 150 && ok; ++i) for (int j = 0; j < 70; ++j) ok = ok && c[i][j] == ref[i][j];
+        for (int i = 0; i < 150 && ok; ++i) for (int j = 0; j < 100; ++j) ok = ok && at[j][i] == a[i][j];
+        ta.tileWrite(4, 3)[5 * 32 + 2] = 42; // 元素(133, 98)
+        ok = ok && ta.toMAT()[133][98] == 42;
+        const TileIOStats& s = ta.stats();
+        cout << (ok ? "分块文件矩阵正确" : "分块文件矩阵错误") << "  读入" << s.bytesRead / 1024 << "KB 写出"
+             << s.bytesWritten / 1024 << "KB 命中" << s.hits << " 未命中" << s.misses << " 预取" << s.prefetched << endl;
+    }
+    catch (const std::exception& ex) {
+        std::cout << "异常: " << ex.what() << std::endl;
+    }
+    int bad = 0;
+    for (int k = 0; k < 3; ++k) {
+        try { TiledMAT<double> t(k == 0 ? -1 : 4, k == 1 ? -1 : 4, k == 2 ? 0 : 2); }
+        catch (const std::invalid_argument&) { ++bad; }
+    }
+    cout << (bad == 3 ? "分块矩阵参数检查正确" : "分块矩阵参数检查错误") << endl;
+}
+
+// 分块文件矩阵基准: 缓存只容纳少数块时的乘法、转置，对比内存中的MAT
+void benchTiledMAT(int n, int ts, int cacheTiles) {
+    MAT<double> a(n, n), b(n, n);
+    for (int i = 0; i < n; ++i) for (int j = 0; j < n; ++j) {
+        a[i][j] = ((i * 31 + j * 17) % 97) / 97.0;
+        b[i][j] = ((i * 13 + j * 7) % 89) / 89.0;
+    }
+    auto ms = [](std::chrono::steady_clock::time_point t0, std::chrono::steady_clock::time_point t1) {
+        return std::chrono::duration<double, std::milli>(t1 - t0).count();
+    };
+    auto t0 = std::chrono::steady_clock::now();
+    MAT<double> c = a * b;
+    MAT<double> at = ~a;
+    auto t1 = std::chrono::steady_clock::now();
+    TiledMAT<double> ta(a, ts, cacheTiles), tb(b, ts, cacheTiles);
+    ta.flush();
+    tb.flush();
+    ta.resetStats();
+    tb.resetStats();
+    auto t2 = std::chrono::steady_clock::now();
+    TiledMAT<double> tc = ta * tb;
+    tc.flush();
+    auto t3 = std::chrono::steady_clock::now();
+    TiledMAT<double> tt = ~ta;
+    tt.flush();
+    auto t4 = std::chrono::steady_clock::now();
+    const double mb = (double)(ta.stats().bytesRead + tb.stats().bytesRead + tc.stats().bytesWritten) / (1 << 20);
+    cout << "分块文件矩阵 " << n << "x" << n << " 块" << ts << " 缓存" << cacheTiles << "块(" << cacheTiles * ts * ts * 8 / 1024
+         << "KB)  内存乘法+转置 " << ms(t0, t1) << " ms  分块乘法 " << ms(t2, t3) << " ms  分块转置 " << ms(t3, t4)
+         << " ms  乘法I/O " << mb << " MB (" << mb / (ms(t2, t3) / 1000) << " MB/s)  预取命中 "
+         << ta.stats().prefetched + tb.stats().prefetched << "/" << ta.stats().misses + tb.stats().misses
+         << (tc.toMAT()[n - 1][n - 1] == c[n - 1][n - 1] ? "" : "  (结果不一致)") << endl;
+}
+
+// 缓冲池测试: 临时结果释放后同尺寸的分配命中池，超出上限的释放归还系统
+void testMatPool() {
+    MatPool& pool = *MatPool::local();
+    const size_t oldLimit = pool.limit();
+    pool.trim();
+    MAT<double> a(20, 30), b(20, 30);
+    for (int i = 0; i < 20; ++i) for (int j = 0; j < 30; ++j) { a[i][j] = i; b[i][j] = j; }
+    pool.resetStats();
+    const void* first = nullptr;
+    bool ok = true;
+    for (int k = 0; k < 5; ++k) {
+        MAT<double> c = a + b; // 第一次向系统分配，之后复用同一块
+        if (k == 0) first = c.data();
+        ok = ok && c.data() == first && c[19][29] == 48;
+    }
+    MatPool::Stats s = pool.stats();
+    ok = ok && s.misses == 1 && s.hits == 4 && s.retained > 0;
+    MAT<double> z(20, 30); // 复用的块也须是全零
+    ok = ok && z[5][7] == 0;
+    pool.setLimit(0);
+    { MAT<double> d = a - b; }
+    ok = ok && pool.stats().retained == 0 && pool.stats().dropped > 0;
+    pool.setLimit(oldLimit);
+    cout << (ok ? "缓冲池正确" : "缓冲池错误") << "  命中" << s.hits << " 未命中" << s.misses << endl;
+}
+
+// 缓冲池基准: 表达式密集的迭代(每步4个临时矩阵)，分别关闭、开启缓冲池
+void benchMatPool() {
+    MatPool& pool = *MatPool::local();
+    const size_t oldLimit = pool.limit();
+    const int sizes[] = { 8, 64, 256, 512 };
+    for (int n : sizes) {
+        MAT<double> a(n, n), b(n, n), acc(n, n);
+        for (int i = 0; i < n; ++i) for (int j = 0; j < n; ++j) { a[i][j] = (i + j) % 7; b[i][j] = (i * j) % 5; }
+        const int reps = std::max(20, (int)(40000000LL / ((long long)n * n)));
+        double t[2];
+        for (int mode = 0; mode < 2; ++mode) {
+            pool.setLimit(mode ? oldLimit : 0);
+            pool.resetStats();
+            auto t0 = std::chrono::steady_clock::now();
+            for (int k = 0; k < reps; ++k) acc = acc * 0.5 + (a - b) * 0.25;
+            auto t1 = std::chrono::steady_clock::now();
+            t[mode] = std::chrono::duration<double, std::micro>(t1 - t0).count() / reps;
+        }
+        const MatPool::Stats& s = pool.stats();
+        cout << "缓冲池 " << n << "x" << n << "  每步 无池 " << t[0] << " us  有池 " << t[1] << " us  命中率 "
+             << 100.0 * s.hits / std::max(1ULL, s.hits + s.misses) << "%" << endl;
+    }
+    pool.setLimit(oldLimit);
+}
+
+// 存储顺序: 列优先的r×c矩阵在内存中与行优先的c×r矩阵(即其转置)完全相同
+enum class MatLayout { RowMajor, ColMajor };
+
+inline MatLayout flip(MatLayout l) {
+    return l == MatLayout::RowMajor ? MatLayout::ColMajor : MatLayout::RowMajor;
+}
+
+// 分块加减: Z(m×n) = X ± Yᵀ，Y按n×m存放；32×32分块使Y按列读取时仍留在缓存中
+template <typename T>
+void matBlockAddT(const T* X, int ldx, const T* Y, int ldy, T* Z, int ldz, int m, int n, bool sub) {
+    const int B = 32;
+    for (int i0 = 0; i0 < m; i0 += B)
+        for (int j0 = 0; j0 < n; j0 += B)
+            for (int i = i0; i < std::min(m, i0 + B); ++i) {
+                const T* x = X + (size_t)i * ldx;
+                T* z = Z + (size_t)i * ldz;
+                for (int j = j0; j < std::min(n, j0 + B); ++j) {
+                    const T y = Y[(size_t)j * ldy + i];
+                    z[j] = sub ? x[j] - y : x[j] + y;
+                }
+            }
+}
+
+template <typename T> class LayoutMAT;
+
+// 带存储顺序的只读视图: s为按行优先解释的物理存储，列优先时s是逻辑矩阵的转置
+// 转置只翻转存储顺序标记，不移动元素
+template <typename T>
+struct LayoutView {
+    MatView<const T> s;
+    MatLayout layout;
+
+    int rows() const { return layout == MatLayout::RowMajor ? s.rows() : s.cols(); }
+    int cols() const { return layout == MatLayout::RowMajor ? s.cols() : s.rows(); }
+    T operator()(int i, int j) const { return layout == MatLayout::RowMajor ? s[i][j] : s[j][i]; }
+    LayoutView operator~() const { return { s, flip(layout) }; }
+
+    // 乘法: 按两操作数的存储顺序选gemm的转置组合，结果取a的存储顺序
+    // 列优先结果存的是Cᵀ = op(B)ᵀ·op(A)ᵀ，故交换操作数；两者都列优先时仍落到不转置的核上
+    friend LayoutMAT<T> operator*(LayoutView a, LayoutView b) {
+        if (a.cols() != b.rows()) throw std::invalid_argument("矩阵乘法维度不符");
+        const bool ac = a.layout == MatLayout::ColMajor, bc = b.layout == MatLayout::ColMajor;
+        LayoutMAT<T> res(a.rows(), b.cols(), a.layout);
+        if (!ac) gemm(T(1), a.s, false, b.s, bc, T(0), res.storage());
+        else gemm(T(1), b.s, !bc, a.s, false, T(0), res.storage());
+        return res;
+    }
+    // 加减: 存储顺序相同时逐行相加，不同时分块转置着读b；结果取a的存储顺序
+    friend LayoutMAT<T> operator+(LayoutView a, LayoutView b) {
+        return addSub(a, b, false);
+    }
+    friend LayoutMAT<T> operator-(LayoutView a, LayoutView b) {
+        return addSub(a, b, true);
+    }
+
+private:
+    static LayoutMAT<T> addSub(LayoutView a, LayoutView b, bool sub) {
+        if (a.rows() != b.rows() || a.cols() != b.cols()) throw std::invalid_argument("矩阵加减维度不符");
+        LayoutMAT<T> res(a.rows(), a.cols(), a.layout);
+        MatView<T> z = res.storage();
+        if (a.layout == b.layout)
+            matBlockAdd(a.s.data(), a.s.stride(), b.s.data(), b.s.stride(), z.data(), z.stride(), z.rows(), z.cols(), sub);
+        else
+            matBlockAddT(a.s.data(), a.s.stride(), b.s.data(), b.s.stride(), z.data(), z.stride(), z.rows(), z.cols(), sub);
+        return res;
+    }
+};
+
+// 带存储顺序的矩阵: 物理存储为行优先的MAT，列优先时存放逻辑矩阵的转置
+template <typename T>
+class LayoutMAT {
+    MAT<T> s;
+    MatLayout lay;
+public:
+    LayoutMAT(int r, int c, MatLayout l = MatLayout::RowMajor)
+        : s(l == MatLayout::RowMajor ? r : c, l == MatLayout::RowMajor ? c : r), lay(l) {}
+    // 接管已有存储，按l解释
+    LayoutMAT(MAT<T>&& m, MatLayout l) : s(std::move(m)), lay(l) {}
+
+    // 由列优先数据构造(第j列的r个元素始于data + j*ld): 逐列顺序复制即可，无需转置
+    static LayoutMAT fromColMajor(const T* data, int r, int c, int ld) {
+        LayoutMAT res(r, c, MatLayout::ColMajor);
+        for (int j = 0; j < c; ++j) std::copy_n(data + (size_t)j * ld, r, res.s[j]);
+        return res;
+    }
+
+    T& operator()(int i, int j) { return lay == MatLayout::RowMajor ? s[i][j] : s[j][i]; }
+    T operator()(int i, int j) const { return lay == MatLayout::RowMajor ? s[i][j] : s[j][i]; }
+
+    LayoutView<T> view() const { return { s.view(), lay }; }
+    operator LayoutView<T>() const { return view(); }
+    // 转置视图与就地转置: 只翻转存储顺序标记
+    LayoutView<T> operator~() const { return ~view(); }
+    LayoutMAT& transpose() {
+        lay = flip(lay);
+        return *this;
+    }
+
+    friend LayoutMAT operator*(const LayoutMAT& a, const LayoutMAT& b) { return a.view() * b.view(); }
+    friend LayoutMAT operator+(const LayoutMAT& a, const LayoutMAT& b) { return a.view() + b.view(); }
+    friend LayoutMAT operator-(const LayoutMAT& a, const LayoutMAT& b) { return a.view() - b.view(); }
+
+    // 转为行优先的MAT: 列优先时此时才实际转置
+    MAT<T> toRowMajor() const {
+        return lay == MatLayout::RowMajor ? MAT<T>(s) : MAT<T>(~s);
+    }
+
+    // 物理存储
+    MatView<T> storage() { return s.view(); }
+    MatView<const T> storage() const { return s.view(); }
+    MatLayout layout() const { return lay; }
+    // 行数
+    int rows() const { return lay == MatLayout::RowMajor ? s.rows() : s.cols(); }
+    // 列数
+    int cols() const { return lay == MatLayout::RowMajor ? s.cols() : s.rows(); }
+};
+
+// 存储顺序测试: 四种组合的乘法、混合顺序的加法与行优先结果对比，转置不复制
+void testLayout() {
+    const int m = 5, k = 7, n = 3;
+    MAT<double> a(m, k), b(k, n);
+    for (int i = 0; i < m; ++i) for (int j = 0; j < k; ++j) a[i][j] = i * 3 - j;
+    for (int i = 0; i < k; ++i) for (int j = 0; j < n; ++j) b[i][j] = (i + 1) * (j - 1);
+    MAT<double> ref = a * b;
+    std::vector<double> colA((size_t)m * k);
+    for (int j = 0; j < k; ++j) for (int i = 0; i < m; ++i) colA[(size_t)j * m + i] = a[i][j];
+    LayoutMAT<double> ar(MAT<double>(a), MatLayout::RowMajor), ac = LayoutMAT<double>::fromColMajor(colA.data(), m, k, m);
+    LayoutMAT<double> br(MAT<double>(b), MatLayout::RowMajor), bc(MAT<double>(~b), MatLayout::ColMajor);
+    bool ok = ac.layout() == MatLayout::ColMajor && ac(4, 6) == a[4][6];
+    const LayoutMAT<double>* as[] = { &ar, &ac };
+    const LayoutMAT<double>* bs[] = { &br, &bc };
+    for (auto x : as) for (auto y : bs) {
+        LayoutMAT<double> c = *x * *y;
+        ok = ok && c.layout() == x->layout() && c.rows() == m && c.cols() == n;
+        for (int i = 0; i < m; ++i) for (int j = 0; j < n; ++j) ok = ok && c(i, j) == ref[i][j];
+    }
+    LayoutMAT<double> s = ar + ac, d = ac - ar;
+    for (int i = 0; i < m; ++i) for (int j = 0; j < k; ++j) ok = ok && s(i, j) == 2 * a[i][j] && d(i, j) == 0;
+    const double* before = ac.storage().data();
+    ac.transpose();
+    ok = ok && ac.layout() == MatLayout::RowMajor && ac.rows() == k && ac.storage().data() == before && ac(6, 4) == a[4][6];
+    MAT<double> gram = (ac * ar).toRowMajor(), g = ~a * a; // ac此时为aᵀ
+    for (int i = 0; i < k; ++i) for (int j = 0; j < k; ++j) ok = ok && gram[i][j] == g[i][j];
+    cout << (ok ? "存储顺序正确" : "存储顺序错误") << endl;
+}
+
+// 存储顺序基准: 乘法的四种存储顺序组合，以及读入列优先数据(先转置为行优先 vs 直接按列优先存放)
+void benchLayout(int n) {
+    std::vector<double> colA((size_t)n * n), colB((size_t)n * n);
+    for (size_t i = 0; i < colA.size(); ++i) {
+        colA[i] = (i * 31 % 97) / 97.0;
+        colB[i] = (i * 17 % 89) / 89.0;
+    }
+    auto ms = [](std::chrono::steady_clock::time_point t0, std::chrono::steady_clock::time_point t1) {
+        return std::chrono::duration<double, std::milli>(t1 - t0).count();
+    };
+    auto t0 = std::chrono::steady_clock::now();
+    MAT<double> ra(n, n), rb(n, n);
+    for (int j = 0; j < n; ++j) for (int i = 0; i < n; ++i) { ra[i][j] = colA[(size_t)j * n + i]; rb[i][j] = colB[(size_t)j * n + i]; }
+    auto t1 = std::chrono::steady_clock::now();
+    LayoutMAT<double> ca = LayoutMAT<double>::fromColMajor(colA.data(), n, n, n);
+    LayoutMAT<double> cb = LayoutMAT<double>::fromColMajor(colB.data(), n, n, n);
+    auto t2 = std::chrono::steady_clock::now();
+    cout << "存储顺序 " << n << "x" << n << "  读入列优先数据: 转置为行优先 " << ms(t0, t1) << " ms  按列优先存放 " << ms(t1, t2) << " ms" << endl;
+
+    LayoutMAT<double> la(std::move(ra), MatLayout::RowMajor), lb(std::move(rb), MatLayout::RowMajor);
+    const LayoutMAT<double>* as[] = { &la, &ca };
+    const LayoutMAT<double>* bs[] = { &lb, &cb };
+    const char* names[] = { "行", "列" };
+    double ref = 0;
+    for (int x = 0; x < 2; ++x)
+        for (int y = 0; y < 2; ++y) {
+            t0 = std::chrono::steady_clock::now();
+            LayoutMAT<double> c = *as[x] * *bs[y];
+            t1 = std::chrono::steady_clock::now();
+            if (x + y == 0) ref = c(n - 1, 0);
+            cout << "  " << names[x] << "优先 * " << names[y] << "优先  " << ms(t0, t1) << " ms"
+                 << (std::fabs(c(n - 1, 0) - ref) <= 1e-12 * std::fabs(ref) ? "" : "  (结果不一致)") << endl;
+        }
+}
+
+// 尺寸检查: 负维度与元素个数溢出须抛异常，不得分配出错误大小的内存
+void testMatSize() {
+    bool neg = false, big = false;
+    try { MAT<double> a(-1, 3); }
+    catch (const std::invalid_argument&) { neg = true; }
+    try { MAT<double> a(INT_MAX, INT_MAX); } // 2^62个元素，字节数超出size_t
+    catch (const std::length_error&) { big = true; }
+    catch (const std::bad_alloc&) { big = true; } // 32位平台上元素个数已溢出前可能先报分配失败
+    cout << (neg ? "负维度检查正确" : "负维度检查错误") << endl;
+    cout << (big ? "元素个数溢出检查正确" : "元素个数溢出检查错误") << endl;
+    bool wrap = false;
+    try { matCheckedMul(SIZE_MAX / 2 + 1, 2); }
+    catch (const std::length_error&) { wrap = true; }
+    cout << (wrap ? "尺寸乘法溢出检查正确" : "尺寸乘法溢出检查错误") << endl;
+}
+
+// 越过32位边界的大矩阵测试(约2.2GB，需大内存机器，main以bigtest参数运行)
+// n*n个int8元素超过2^31，末行首地址的偏移亦超过INT_MAX
+void testMatBig(int n = 46341) {
+    MAT<int8_t> a(n, n), x(n, 1);
+    cout << "大矩阵 " << n << "x" << n << ", 共" << (size_t)n * a.stride() << "个元素" << endl;
+    for (int i = 0; i < n; ++i) {
+        int8_t* ai = a[i];
+        for (int j = 0; j < n; ++j) ai[j] = int8_t((i + j) & 1);
+    }
+    for (int j = 0; j < n; ++j) x[j][0] = 1;
+    auto t0 = std::chrono::steady_clock::now();
+    MAT<int8_t> y = a * x;
+    double ms = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - t0).count();
+    bool ok = true;
+    for (int i : {0, 1, n - 2, n - 1}) {
+        long long want = (n + ((i & 1) ? 1 : 0)) / 2; // 第i行中(i+j)为奇数的j个数
+        ok = ok && y[i][0] == int8_t(want & 0xff) && a[i][n - 1] == int8_t((i + n - 1) & 1);
+    }
+    cout << "大矩阵乘法 " << ms << " ms, " << (ok ? "结果正确" : "结果错误") << endl;
+}
+
+// 有界环形队列: 沿用exp2中QUEUE的设计(定长数组、首尾指针、留一个空位区分满与空)，
+// 加互斥锁与条件变量供多线程使用；队满时enter阻塞，上游因而放慢，形成反压
+// 元素按批进出，每批只取一次锁
+template <typename Item>
+class MatRing {
+    std::unique_ptr<Item[]> elems;
+    const size_t max;
+    size_t head = 0, tail = 0;
+    bool closed = false, aborted = false;
+    std::mutex m;
+    std::condition_variable notEmpty, notFull;
+
+    size_t number() const { return tail >= head ? tail - head : tail + max - head; }
+public:
+    // capacity为最多容纳的元素个数
+    explicit MatRing(size_t capacity) : elems(new Item[capacity + 1]), max(capacity + 1) {
+        if (capacity == 0) throw std::invalid_argument("队列容量须为正");
+    }
+
+    // 批量入队，队满时等待下游腾出空位；已关闭时返回false，未入队的元素丢弃
+    bool enter(std::vector<Item>& batch) {
+        std::unique_lock<std::mutex> lock(m);
+        size_t i = 0;
+        while (i < batch.size()) {
+            notFull.wait(lock, [&] { return closed || number() + 1 < max; });
+            if (closed) {
+                batch.clear();
+                return false;
+            }
+            for (; i < batch.size() && number() + 1 < max; ++i) {
+                elems[tail] = std::move(batch[i]);
+                tail = (tail + 1) % max;
+            }
+            notEmpty.notify_all();
+        }
+        batch.clear();
+        return true;
+    }
+
+    // 批量出队至多n个，队空时等待；关闭且取空或中止后返回false
+    bool leave(std::vector<Item>& out, size_t n) {
+        out.clear();
+        std::unique_lock<std::mutex> lock(m);
+        notEmpty.wait(lock, [&] { return closed || head != tail; });
+        if (aborted) return false;
+        for (; out.size() < n && head != tail; head = (head + 1) % max) out.push_back(std::move(elems[head]));
+        notFull.notify_all();
+        return !out.empty();
+    }
+
+    // 不再入队: 下游取完剩余元素后结束
+    void close() {
+        std::lock_guard<std::mutex> lock(m);
+        closed = true;
+        notEmpty.notify_all();
+        notFull.notify_all();
+    }
+    // 出错时中止: 两端立即返回false
+    void abort() {
+        std::lock_guard<std::mutex> lock(m);
+        closed = aborted = true;
+        notEmpty.notify_all();
+        notFull.notify_all();
+    }
+};
+
+// 流水线各阶段的统计，时间为该阶段各工作线程之和
+struct MatStageStats {
+    std::string name;
+    int workers = 0;
+    size_t items = 0, batches = 0;
+    double busyMs = 0;    // 处理元素
+    double inWaitMs = 0;  // 等上游(输入队列空)
+    double outWaitMs = 0; // 等下游(输出队列满，即反压)
+};
+
+// 多阶段流水线: 源 → 各阶段 → 汇，相邻阶段之间是一个有界MatRing
+// 每个阶段可有多个工作线程，各自按批取出、逐个处理、按批送往下一阶段；同一阶段多线程时元素的先后次序不保证
+// 各阶段同时运行，读文件等I/O与计算相互重叠；某阶段出异常时中止全部队列，run()重新抛出
+template <typename Item>
+class MatPipeline {
+    struct Stage {
+        std::string name;
+        int workers;
+        std::function<void(Item&)> fn;
+    };
+    std::vector<Stage> stages;
+    size_t cap, batch;
+
+    static double msSince(std::chrono::steady_clock::time_point& t) {
+        auto now = std::chrono::steady_clock::now();
+        double ms = std::chrono::duration<double, std::milli>(now - t).count();
+        t = now;
+        return ms;
+    }
+public:
+    // cap为每个队列的容量，batch为阶段间每批传递的元素个数
+    explicit MatPipeline(size_t cap_ = 64, size_t batch_ = 4) : cap(cap_), batch(batch_ ? batch_ : 1) {
+        if (cap < batch) throw std::invalid_argument("队列容量不能小于批大小");
+    }
+
+    MatPipeline& stage(std::string name, int workers, std::function<void(Item&)> fn) {
+        if (workers <= 0) throw std::invalid_argument("工作线程数须为正");
+        stages.push_back({ std::move(name), workers, std::move(fn) });
+        return *this;
+    }
+
+    // 运行到源耗尽: source每次填写一个元素，返回false表示结束；sink在调用线程中接收每个最终元素
+    // 返回源、各阶段、汇的统计
+    std::vector<MatStageStats> run(std::function<bool(Item&)> source, std::function<void(Item&)> sink) {
+        const size_t n = stages.size();
+        std::vector<std::unique_ptr<MatRing<Item>>> rings;
+        for (size_t k = 0; k <= n; ++k) rings.emplace_back(new MatRing<Item>(cap));
+        std::vector<MatStageStats> st(n + 2);
+        st[0].name = "source";
+        st[0].workers = 1;
+        for (size_t k = 0; k < n; ++k) {
+            st[k + 1].name = stages[k].name;
+            st[k + 1].workers = stages[k].workers;
+        }
+        st[n + 1].name = "sink";
+        st[n + 1].workers = 1;
+
+        std::mutex sm; // 保护st与err
+        std::exception_ptr err;
+        const auto fail = [&] {
+            {
+                std::lock_guard<std::mutex> lock(sm);
+                if (!err) err = std::current_exception();
+            }
+            for (auto& r : rings) r->abort();
+        };
+        const auto merge = [&](size_t k, const MatStageStats& s) {
+            std::lock_guard<std::mutex> lock(sm);
+            st[k].items += s.items;
+            st[k].batches += s.batches;
+            st[k].busyMs += s.busyMs;
+            st[k].inWaitMs += s.inWaitMs;
+            st[k].outWaitMs += s.outWaitMs;
+        };
+
+        std::vector<std::thread> threads;
+        threads.emplace_back([&] {
+            MatStageStats s;
+            try {
+                std::vector<Item> out;
+                auto t = std::chrono::steady_clock::now();
+                for (bool more = true; more;) {
+                    out.emplace_back();
+                    more = source(out.back());
+                    if (!more) out.pop_back();
+                    s.busyMs += msSince(t);
+                    if (out.size() == batch || (!more && !out.empty())) {
+                        s.items += out.size();
+                        ++s.batches;
+                        if (!rings[0]->enter(out)) break;
+                        s.outWaitMs += msSince(t);
+                    }
+                }
+                rings[0]->close();
+            }
+            catch (...) {
+                fail();
+            }
+            merge(0, s);
+        });
+        std::vector<std::unique_ptr<std::atomic<int>>> alive;
+        for (size_t k = 0; k < n; ++k) {
+            alive.emplace_back(new std::atomic<int>(stages[k].workers));
+            for (int w = 0; w < stages[k].workers; ++w) {
+                threads.emplace_back([&, k] {
+                    MatStageStats s;
+                    try {
+                        std::vector<Item> items;
+                        auto t = std::chrono::steady_clock::now();
+                        while (rings[k]->leave(items, batch)) {
+                            s.inWaitMs += msSince(t);
+                            for (Item& it : items) stages[k].fn(it);
+                            s.items += items.size();
+                            ++s.batches;
+                            s.busyMs += msSince(t);
+                            if (!rings[k + 1]->enter(items)) break;
+                            s.outWaitMs += msSince(t);
+                        }
+                        s.inWaitMs += msSince(t);
+                        // 本阶段最后一个结束的线程关闭输出队列
+                        if (--*alive[k] == 0) rings[k + 1]->close();
+                    }
+                    catch (...) {
+                        fail();
+                    }
+                    merge(k + 1, s);
+                });
+            }
+        }
+        {
+            MatStageStats s;
+            try {
+                std::vector<Item> items;
+                auto t = std::chrono::steady_clock::now();
+                while (rings[n]->leave(items, batch)) {
+                    s.inWaitMs += msSince(t);
+                    for (Item& it : items) sink(it);
+                    s.items += items.size();
+                    ++s.batches;
+                    s.busyMs += msSince(t);
+                }
+                s.inWaitMs += msSince(t);
+            }
+            catch (...) {
+                fail();
+            }
+            merge(n + 1, s);
+        }
+        for (auto& th : threads) th.join();
+        if (err) std::rethrow_exception(err);
+        return st;
+    }
+};
+
+// 流水线测试: 多线程阶段的结果与串行一致；队列容量小于元素总数时依靠反压运行；阶段抛出的异常由run()抛出
+void testMatPipeline() {
+    using Item = std::pair<int, long long>;
+    MatPipeline<Item> p(8, 3);
+    p.stage("square", 3, [](Item& x) { x.second = (long long)x.first * x.first; })
+     .stage("inc", 2, [](Item& x) { x.second += 1; });
+    int next = 0;
+    long long sum = 0;
+    size_t count = 0;
+    std::vector<MatStageStats> st = p.run([&](Item& x) { x.first = next; return next++ < 1000; },
+        [&](Item& x) { sum += x.second; ++count; });
+    long long want = 0;
+    for (long long i = 0; i < 1000; ++i) want += i * i + 1;
+    bool ok = count == 1000 && sum == want && st.size() == 4 && st[1].items == 1000 && st[3].items == 1000;
+
+    bool thrown = false;
+    MatPipeline<Item> bad(8, 3);
+    bad.stage("fail", 2, [](Item& x) { if (x.first == 500) throw std::runtime_error("阶段出错"); });
+    next = 0;
+    try {
+        bad.run([&](Item& x) { x.first = next; return next++ < 1000; }, [](Item&) {});
+    }
+    catch (const std::runtime_error&) {
+        thrown = true;
+    }
+    cout << (ok ? "流水线结果正确" : "流水线结果错误") << endl;
+    cout << (thrown ? "流水线异常传递正确" : "流水线异常传递错误") << endl;
+}
+
+// 流水线作业: 读入矩阵 → 转置并缩放 → 相乘 → 求范数
+struct MatPipeJob {
+    int id = 0;
+    std::unique_ptr<MAT<double>> a, b;
+    double result = 0;
+};
+
+// 流水线基准: 串行逐个作业与流水线(各阶段1线程、乘法阶段多线程)的吞吐量对比
+void benchMatPipeline(int n, int jobs) {
+    const char* path = "exp5_pipe_bench.bin";
+    {
+        MAT<double> a(n, n);
+        for (int i = 0; i < n; ++i)
+            for (int j = 0; j < n; ++j) a[i][j] = ((i * 31 + j * 17) % 23 - 11) / 8.0;
+        matSave(a, path);
+    }
+    const auto load = [&](MatPipeJob& j) { j.a.reset(new MAT<double>(matLoad<double>(path))); };
+    const auto transform = [](MatPipeJob& j) {
+        j.b.reset(new MAT<double>(~*j.a));
+        *j.b *= 0.5;
+    };
+    const auto multiply = [](MatPipeJob& j) { j.a.reset(new MAT<double>(*j.a * *j.b)); j.b.reset(); };
+    const auto reduce = [](MatPipeJob& j) { j.result = matNormFro(j.a->view()); j.a.reset(); };
+
+    auto t0 = std::chrono::steady_clock::now();
+    double serialSum = 0;
+    for (int i = 0; i < jobs; ++i) {
+        MatPipeJob j;
+        j.id = i;
+        load(j);
+        transform(j);
+        multiply(j);
+        reduce(j);
+        serialSum += j.result;
+    }
+    double serialMs = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - t0).count();
+    cout << "pipeline " << n << "x" << n << " x" << jobs << ": serial " << serialMs << " ms, "
+         << jobs * 1000.0 / serialMs << " jobs/s" << endl;
+
+    const int hw = std::max(1, (int)std::thread::hardware_concurrency());
+    std::vector<int> mulWorkers = { 1 };
+    if (hw > 1) mulWorkers.push_back(hw);
+    for (int w : mulWorkers) {
+        MatPipeline<MatPipeJob> p(8, 2);
+        p.stage("load", 1, load).stage("transform", 1, transform).stage("multiply", w, multiply).stage("reduce", 1, reduce);
+        int next = 0;
+        double sum = 0;
+        t0 = std::chrono::steady_clock::now();
+        std::vector<MatStageStats> st = p.run([&](MatPipeJob& j) { j.id = next; return next++ < jobs; },
+            [&](MatPipeJob& j) { sum += j.result; });
+        double ms = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - t0).count();
+        cout << "pipeline multiply x" << w << ": " << ms << " ms, " << jobs * 1000.0 / ms << " jobs/s, speedup "
+             << serialMs / ms << (std::fabs(sum - serialSum) <= 1e-9 * std::fabs(serialSum) ? "" : " MISMATCH") << endl;
+        for (const MatStageStats& s : st)
+            cout << "  " << std::setw(10) << s.name << " x" << s.workers << ": items " << s.items << ", busy " << s.busyMs
+                 << " ms, wait in " << s.inWaitMs << " ms, wait out " << s.outWaitMs << " ms" << endl;
+    }
+    remove(path);
+}
+
+// 剖析测试: 启用时乘法、转置分别计入对应运算名与规模档；未启用时导出只有enabled:false
+void testMatProfile() {
+    matProfileReset();
+    MAT<double> a(100, 60), b(60, 100);
+    MAT<double> c = a * b;
+    MAT<double> t = ~a;
+    std::ostringstream os;
+    matProfileDump(os);
+#if MAT_PROFILE
+    const MatProfiler::Entry mul = MatProfiler::instance().find("mul", 128), tr = MatProfiler::instance().find("transpose", 128);
+    bool ok = mul.calls == 1 && tr.calls == 1 && mul.sum.ns > 0 && os.str().find("\"op\": \"mul\", \"size\": 128, \"calls\": 1") != std::string::npos;
+#else
+    bool ok = os.str().find("\"enabled\": false") != std::string::npos;
+#endif
+    cout << (ok ? "剖析统计正确" : "剖析统计错误") << endl;
+    matProfileReset();
+}
+
+// 剖析各规模的乘法与转置并以JSON输出；须以-DMAT_PROFILE=1编译，main以profile参数运行
+void profileMatOps(int maxN) {
+    matProfileReset();
+    for (int n = 64; n <= maxN; n *= 2) {
+        MAT<double> a(n, n), b(n, n);
+        for (int i = 0; i < n; ++i)
+            for (int j = 0; j < n; ++j) {
+                a[i][j] = (i * 7 + j * 3) % 11 - 5.0;
+                b[i][j] = (i * 5 + j) % 13 - 6.0;
+            }
+        const int reps = std::max(1, (256 / n) * (256 / n));
+        for (int k = 0; k < reps; ++k) {
+            MAT<double> c = a * b;
+            MAT<double> d = a * ~b;
+            MAT<double> t = ~a;
+        }
+    }
+    matProfileDump(cout);
+}
+
+// 扩展main函数，全面测试
+int main(int argc, char* argv[]) {
+    if (argc > 1 && strcmp(argv[1], "bench") == 0) {
+        benchStrassen<double>("double", 64);
+        benchStrassen<float>("float", 64);
+        benchMatFile(4096);
+        benchMatFormat();
+        benchMatBatch();
+        benchMatMulInt(512);
+        benchGemm(64, 200);
+        benchGemm(256, 10);
+        benchMatPowChain();
+        benchMatReduce(2048);
+        benchMatAcc(64, 16384, 64);
+        benchLU(argc > 2 ? atoi(argv[2]) : 2048); // bench 8192: LU测到8192阶
+        benchTiledMAT(1024, 256, 4);
+        benchMatPool();
+        benchLayout(512);
+        benchMatPipeline(256, 48);
+        return 0;
+    }
+    if (argc > 1 && strcmp(argv[1], "profile") == 0) {
+        profileMatOps(argc > 2 ? atoi(argv[2]) : 1024);
+        return 0;
+    }
+    if (argc > 1 && strcmp(argv[1], "bigtest") == 0) {
+        testMatBig();
+        return 0;
+    }
+
+    testFixedMAT();
+    testMatView();
+    testTransView();
+    testStrassen();
+    testSparse();
+    testMatFile();
+    testMatFormat();
+    testMatBatch();
+    testMatMulInt();
+    testGemm();
+    testMatPowChain();
+    testMatReduce();
+    testMatAcc();
+    testLU();
+    testTiledMAT();
+    testMatPool();
+    testLayout();
+    testMatSize();
+    testMatProfile();
+    testMatPipeline();
 
-// 扩展main函数，全面测试
-int main(int argc, char* argv[]) {
     MAT<int> a(1, 2), b(2, 2), c(1, 2);
     char t[2048];
 